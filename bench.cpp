@@ -0,0 +1,601 @@
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include "tetris_core.hpp"
+#include "tetris_render.hpp"
+#include "tetris_raster.hpp"
+#include "tetris_ai.hpp"
+#include "tetris_pool.hpp"
+#include "tetris_rollback.hpp"
+#include "tetris_env.h"
+#include "bench_c.h"
+
+#undef main
+
+/**
+ * micro and macro benchmarks of both versions of the game.
+ *
+ * build with `make bench`. the report goes to stdout as one JSON document:
+ *
+ *   { "benchmarks": [ { "suite": "cpp", "name": "...", "unit": "ns/op", "value": 1.5 }, ... ] }
+ *
+ * "cpp" results measure tetris_core.hpp / tetris_render.hpp, "c" results measure tetris.c.
+*/
+
+using BenchClock = std::chrono::steady_clock;
+
+constexpr long BENCH_ITERATIONS = 10'000'000;
+constexpr int BENCH_GAMES = 2000;
+constexpr int BENCH_RENDERS = 2000;
+constexpr int BENCH_BOT_PIECES = 20000;
+constexpr int BENCH_SESSIONS = 4096;
+constexpr int BENCH_SESSION_TICKS = 2000;
+constexpr int BENCH_ROLLBACK_FRAMES = 10;
+
+struct BenchResult {
+    std::string suite;
+    std::string name;
+    std::string unit;
+    double value;
+};
+
+std::vector<BenchResult> benchResults;
+
+void report(std::string const& name, std::string const& unit, double value) {
+    benchResults.push_back(BenchResult{ "cpp", name, unit, value });
+}
+
+extern "C" void bench_report(const char* name, const char* unit, double value) {
+    benchResults.push_back(BenchResult{ "c", name, unit, value });
+}
+
+void print_json_report(std::ostream& out) {
+    out << "{\n  \"benchmarks\": [\n";
+
+    for (std::size_t i = 0; i < benchResults.size(); ++i){
+        BenchResult const& result = benchResults[i];
+
+        out << "    { \"suite\": \"" << result.suite
+            << "\", \"name\": \"" << result.name
+            << "\", \"unit\": \"" << result.unit
+            << "\", \"value\": " << result.value << " }"
+            << (i + 1 < benchResults.size() ? ",\n" : "\n");
+    }
+
+    out << "  ]\n}\n";
+}
+
+/**
+ * keep the compiler from throwing away a value we computed only for timing.
+*/
+template <typename T>
+inline void do_not_optimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+double seconds_since(BenchClock::time_point start) {
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+template <typename Body>
+double bench_ns_per_op(long iterations, Body&& body) {
+    auto start = BenchClock::now();
+
+    for (long i = 0; i < iterations; ++i){
+        body(i);
+    }
+
+    return seconds_since(start) * 1e9 / iterations;
+}
+
+/**
+ * the lower 2 / 3 of the board gets scattered blocks, every row keeps at least one hole.
+*/
+void fill_board(TetrisMap& tetrisMap) {
+    std::mt19937 mt{ 1 };
+
+    for (int r = TETRIS_ALL_HEIGHT / 3; r < TETRIS_ALL_HEIGHT; ++r){
+        for (int c = 0; c < TETRIS_WIDTH; ++c){
+            if (c != r % TETRIS_WIDTH && mt() % 4 != 0){
+                tetrisMap.set(r, c, static_cast<Block>(mt() % 7));
+            }
+        }
+    }
+}
+
+/**
+ * the pre-template signature, kept here only as a baseline to compare against.
+*/
+bool for_each_shape_point_if_erased(BlockInfo const& blockInfo, std::function<bool(int row, int col)> cond) {
+    return blockInfo.for_each_shape_point_if(cond);
+}
+
+void bench_block_info_visitors() {
+    // every block and rotation, padded to a power of two so picking one is a mask, not a division.
+    constexpr int BLOCK_COUNT = 32;
+    BlockInfo blocks[BLOCK_COUNT];
+    for (int i = 0; i < BLOCK_COUNT; ++i){
+        blocks[i] = BlockInfo{ static_cast<Block>((i / 4) % 7), TETRIS_ALL_HEIGHT / 3, TETRIS_WIDTH / 2, i % 4 };
+    }
+
+    TetrisMap tetrisMap;
+    fill_board(tetrisMap);
+
+    report("for_each_shape_point_if/template", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        BlockInfo const& blockInfo = blocks[i & (BLOCK_COUNT - 1)];
+        bool hit = blockInfo.for_each_shape_point_if([&tetrisMap](int row, int col) {
+            return col < 0 || col >= TETRIS_WIDTH || row >= TETRIS_ALL_HEIGHT || tetrisMap.is_occupied(row, col);
+        });
+        do_not_optimize(hit);
+    }));
+
+    report("for_each_shape_point_if/std::function", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        BlockInfo const& blockInfo = blocks[i & (BLOCK_COUNT - 1)];
+        bool hit = for_each_shape_point_if_erased(blockInfo, [&tetrisMap](int row, int col) {
+            return col < 0 || col >= TETRIS_WIDTH || row >= TETRIS_ALL_HEIGHT || tetrisMap.is_occupied(row, col);
+        });
+        do_not_optimize(hit);
+    }));
+
+    report("collides/piece_mask", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        BlockInfo const& blockInfo = blocks[i & (BLOCK_COUNT - 1)];
+        bool hit = tetrisMap.collides(blockInfo.get_mask(), blockInfo.get_pos().row);
+        do_not_optimize(hit);
+    }));
+
+    report("for_each_shape_point/template", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        int sum = 0;
+        blocks[i & (BLOCK_COUNT - 1)].for_each_shape_point([&sum](int row, int col) {
+            sum += row * TETRIS_WIDTH + col;
+        });
+        do_not_optimize(sum);
+    }));
+}
+
+void bench_moves() {
+    TetrisGame game{ 1 };
+
+    // left and right alternate, so the block wanders between two columns and never locks.
+    report("move_left_right", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        if (i & 1){
+            game.move_right();
+        }
+        else {
+            game.move_left();
+        }
+        do_not_optimize(game.get_block_info());
+    }));
+
+    // every block and rotation, from the spawn row onto an empty board: the longest fall.
+    TetrisMap tetrisMap;
+    auto spawned = [](long i) {
+        return BlockInfo{ static_cast<Block>((i >> 2) % 7), 2, TETRIS_WIDTH / 2, static_cast<int>(i & 3) };
+    };
+
+    report("drop/repeated-down", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        BlockInfo blockInfo = spawned(i);
+        while (try_move(tetrisMap, blockInfo, Action::Down)) {}
+        do_not_optimize(blockInfo);
+    }));
+
+    report("drop/column-tops", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        BlockInfo blockInfo = spawned(i);
+        try_move(tetrisMap, blockInfo, Action::HardDrop);
+        do_not_optimize(blockInfo);
+    }));
+}
+
+/**
+ * every iteration rebuilds 4 full rows under a half-filled board and clears them.
+*/
+void bench_eliminate_lines() {
+    TetrisMap board;
+    fill_board(board);
+
+    for (int r = TETRIS_ALL_HEIGHT - 4; r < TETRIS_ALL_HEIGHT; ++r){
+        for (int c = 0; c < TETRIS_WIDTH; ++c){
+            board.set(r, c, Block::I);
+        }
+    }
+
+    long iterations = BENCH_ITERATIONS / 10;
+    TetrisMap tetrisMap;
+
+    double copyNs = bench_ns_per_op(iterations, [&](long) {
+        tetrisMap = board;
+        do_not_optimize(tetrisMap);
+    });
+
+    double clearNs = bench_ns_per_op(iterations, [&](long) {
+        tetrisMap = board;
+        ClearedLines cleared = tetrisMap.eliminate_lines(TETRIS_ALL_HEIGHT - 4, TETRIS_ALL_HEIGHT - 1);
+        do_not_optimize(cleared);
+    });
+
+    report("eliminate_lines/4_lines", "ns/op", clearNs - copyNs);
+
+    report("eliminate_lines/none", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long) {
+        ClearedLines cleared = board.eliminate_lines(TETRIS_ALL_HEIGHT / 2, TETRIS_ALL_HEIGHT / 2 + 3);
+        do_not_optimize(cleared);
+    }));
+}
+
+void bench_random_gen_current_block() {
+    TetrisGame game{ 1 };
+
+    report("random_gen_current_block", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long) {
+        game.random_gen_current_block();
+        do_not_optimize(game.get_block_info());
+    }));
+}
+
+void bench_render() {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, TETRIS_WIDTH * BLOCK_WIDTH, TETRIS_HEIGHT * BLOCK_WIDTH, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr){
+        return;
+    }
+
+    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(surface);
+    if (renderer == nullptr){
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    TetrisMap board;
+    fill_board(board);
+    BlockInfo blockInfo{ Block::T, 2, TETRIS_WIDTH / 2, 0 };
+
+    TetrisRenderer tetrisRenderer{ renderer };
+    auto start = BenchClock::now();
+
+    for (int i = 0; i < BENCH_RENDERS; ++i){
+        tetrisRenderer.render(board, blockInfo);
+    }
+
+    report("render/offscreen", "us/frame", seconds_since(start) * 1e6 / BENCH_RENDERS);
+
+    // baseline: the same frame drawn cell by cell, two colour changes and two draws each.
+    start = BenchClock::now();
+
+    for (int i = 0; i < BENCH_RENDERS; ++i){
+        SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
+        SDL_RenderClear(renderer);
+
+        for (int r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
+            for (int c = 0; c < TETRIS_WIDTH; ++c){
+                if (board.get(r, c) != Block::Empty){
+                    tetrisRenderer.render_block(r, c, board.get(r, c));
+                }
+            }
+        }
+
+        blockInfo.for_each_shape_point([&](int row, int col) {
+            tetrisRenderer.render_block(row, col, blockInfo.get_block());
+        });
+    }
+
+    report("render/offscreen-per-cell", "us/frame", seconds_since(start) * 1e6 / BENCH_RENDERS);
+
+    // a game with one random key per frame, drawn with render_changes(): the surface keeps
+    // the previous frame, like the front-end's canvas texture does.
+    TetrisGame game{ 1 };
+    std::mt19937 mt{ 7 };
+    tetrisRenderer.invalidate();
+    start = BenchClock::now();
+
+    for (int i = 0; i < BENCH_RENDERS; ++i){
+        if (game.is_game_over()){
+            game.reset(static_cast<std::uint32_t>(i));
+            tetrisRenderer.invalidate();
+        }
+
+        game.step(static_cast<Action>(1 + mt() % 4));
+        tetrisRenderer.render_changes(game.get_map(), game.get_block_info(), game.take_dirty_rows());
+    }
+
+    report("render/offscreen-incremental", "us/frame", seconds_since(start) * 1e6 / BENCH_RENDERS);
+
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+}
+
+/**
+ * the software rasteriser, a full frame each time, at the natural size and at 3x (4K).
+*/
+void bench_raster() {
+    TetrisMap board;
+    fill_board(board);
+    BlockInfo blockInfo{ Block::T, 2, TETRIS_WIDTH / 2, 0 };
+
+    for (int scale : { 1, 3 }){
+        TetrisRasterizer rasterizer{ scale };
+        auto start = BenchClock::now();
+
+        for (int i = 0; i < BENCH_RENDERS; ++i){
+            rasterizer.render(board, blockInfo);
+            do_not_optimize(rasterizer.get_pixels()[i % (rasterizer.get_width() * rasterizer.get_height())]);
+        }
+
+        double seconds = seconds_since(start);
+        report("render/raster/scale=" + std::to_string(scale), "us/frame", seconds * 1e6 / BENCH_RENDERS);
+        report("render/raster/scale=" + std::to_string(scale), "Mpixels/s",
+               static_cast<double>(rasterizer.get_width()) * rasterizer.get_height() * BENCH_RENDERS / seconds / 1e6);
+    }
+}
+
+/**
+ * whole games with uniformly random moves, until game over, on a Width x Height board.
+*/
+template <int Width, int Height>
+void bench_games_on(std::string const& suffix) {
+    std::mt19937 mt{ 7 };
+    long moves = 0;
+    auto start = BenchClock::now();
+
+    for (int g = 0; g < BENCH_GAMES; ++g){
+        BasicTetrisGame<Width, Height> game{ static_cast<std::uint32_t>(g) };
+
+        while (!game.is_game_over()){
+            game.step(static_cast<Action>(1 + mt() % 4));
+            ++moves;
+        }
+    }
+
+    double seconds = seconds_since(start);
+    report("games" + suffix, "games/s", BENCH_GAMES / seconds);
+    report("moves" + suffix, "moves/s", moves / seconds);
+}
+
+void bench_games() {
+    bench_games_on<TETRIS_WIDTH, TETRIS_HEIGHT>("");
+    bench_games_on<10, 20>("/10x20");
+    bench_games_on<32, 28>("/32x28");
+    bench_games_on<64, 28>("/64x28");
+}
+
+/**
+ * BENCH_SESSIONS concurrent random games, stepped once per tick: as TetrisGame objects,
+ * then in a SessionPool. a game that is over starts again.
+*/
+void bench_sessions() {
+    // the random keys are drawn up front, so both sides only pay for the stepping.
+    std::mt19937 mt{ 7 };
+    std::vector<Action> actions(static_cast<std::size_t>(BENCH_SESSIONS) * 64);
+    for (Action& action : actions){
+        action = static_cast<Action>(1 + mt() % 4);
+    }
+
+    auto actions_of_tick = [&actions](int tick) {
+        return actions.data() + static_cast<std::size_t>(tick % 64) * BENCH_SESSIONS;
+    };
+
+    std::vector<TetrisGame> games;
+    for (int s = 0; s < BENCH_SESSIONS; ++s){
+        games.emplace_back(static_cast<std::uint32_t>(s));
+    }
+
+    auto start = BenchClock::now();
+
+    for (int tick = 0; tick < BENCH_SESSION_TICKS; ++tick){
+        const Action* tickActions = actions_of_tick(tick);
+
+        for (int s = 0; s < BENCH_SESSIONS; ++s){
+            if (games[s].is_game_over()){
+                games[s].reset(static_cast<std::uint32_t>(tick));
+            }
+            games[s].step(tickActions[s]);
+        }
+    }
+
+    double steps = static_cast<double>(BENCH_SESSIONS) * BENCH_SESSION_TICKS;
+    report("sessions/game-objects", "steps/s", steps / seconds_since(start));
+    report("sessions/game-objects", "bytes/session", sizeof(TetrisGame));
+
+    SessionPool pool{ BENCH_SESSIONS };
+    for (int s = 0; s < BENCH_SESSIONS; ++s){
+        pool.add_session(static_cast<std::uint32_t>(s));
+    }
+
+    start = BenchClock::now();
+
+    for (int tick = 0; tick < BENCH_SESSION_TICKS; ++tick){
+        for (int s = 0; s < BENCH_SESSIONS; ++s){
+            if (pool.is_game_over(s)){
+                pool.reset_session(s, static_cast<std::uint32_t>(tick));
+            }
+        }
+        pool.tick(actions_of_tick(tick));
+    }
+
+    report("sessions/pool", "steps/s", steps / seconds_since(start));
+    report("sessions/pool", "bytes/session", SessionPool::get_bytes_per_session());
+}
+
+/**
+ * BENCH_SESSIONS environments of tetris_env.h stepped with random actions, observations
+ * included, as a training loop would drive them.
+*/
+void bench_env() {
+    std::mt19937 mt{ 7 };
+    std::vector<std::uint8_t> actions(static_cast<std::size_t>(BENCH_SESSIONS) * 64);
+    for (std::uint8_t& action : actions){
+        action = static_cast<std::uint8_t>(1 + mt() % 4);
+    }
+
+    std::vector<std::uint8_t> boards(static_cast<std::size_t>(BENCH_SESSIONS) * tetris_env_rows() * tetris_env_cols());
+    std::vector<std::int8_t> pieces(static_cast<std::size_t>(BENCH_SESSIONS) * TETRIS_ENV_PIECE_FIELDS);
+    std::vector<float> rewards(BENCH_SESSIONS);
+    std::vector<std::uint8_t> dones(BENCH_SESSIONS);
+    TetrisEnvBuffers buffers{ boards.data(), pieces.data(), rewards.data(), dones.data() };
+
+    TetrisEnv* env = tetris_env_create(BENCH_SESSIONS, 0, &buffers);
+    auto start = BenchClock::now();
+
+    for (int tick = 0; tick < BENCH_SESSION_TICKS; ++tick){
+        tetris_env_step(env, actions.data() + static_cast<std::size_t>(tick % 64) * BENCH_SESSIONS);
+    }
+
+    report("env/step", "steps/s", static_cast<double>(BENCH_SESSIONS) * BENCH_SESSION_TICKS / seconds_since(start));
+    tetris_env_destroy(env);
+}
+
+/**
+ * versus garbage: rows pushed under a game until it is lost, and a forfeit (a board's
+ * worth of garbage at once, which lifts the block as high as it goes) every 16th time.
+ * the game is then started again, with its block at another height.
+*/
+void bench_garbage() {
+    TetrisGame game{ 1 };
+
+    report("garbage/add", "ns/op", bench_ns_per_op(BENCH_ITERATIONS / 10, [&](long i) {
+        if (game.is_game_over()){
+            game.reset(static_cast<std::uint32_t>(i));
+
+            for (long down = i % 8; down > 0; --down){
+                game.step(Action::Down);
+            }
+        }
+
+        if (i % 16 == 0){
+            game.add_garbage(TETRIS_ALL_HEIGHT, 0);
+        }
+        else {
+            game.add_garbage(2, static_cast<int>(i % TETRIS_WIDTH));
+        }
+        do_not_optimize(game.get_block_info());
+    }));
+}
+
+/**
+ * a snapshot and restore of a whole game, then rollbacks of 1 to BENCH_ROLLBACK_FRAMES
+ * frames: every frame plays a random key, then the key played k frames ago is changed
+ * and the game resimulated from there, as rollback netcode does when a late key arrives.
+*/
+void bench_rollback() {
+    std::mt19937 mt{ 7 };
+    TetrisGame game{ 1 };
+
+    for (int i = 0; i < 1000; ++i){
+        game.step(static_cast<Action>(1 + mt() % 4));
+    }
+
+    TetrisGame::State snapshot = game.get_state();
+    report("rollback/snapshot", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long) {
+        snapshot = game.get_state();
+        do_not_optimize(snapshot);
+    }));
+
+    report("rollback/restore", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long) {
+        game.restore_state(snapshot);
+        do_not_optimize(game.get_state());
+    }));
+
+    report("rollback/snapshot", "bytes", sizeof(TetrisGame::State));
+
+    for (int frames = 1; frames <= BENCH_ROLLBACK_FRAMES; ++frames){
+        RollbackBuffer<TetrisGame> buffer{ BENCH_ROLLBACK_FRAMES + 1 };
+        long iterations = BENCH_ITERATIONS / 100;
+        game.reset(1);
+
+        report("rollback/resimulate-" + std::to_string(frames) + "-frames", "ns/op", bench_ns_per_op(iterations, [&](long i) {
+            if (game.is_game_over()){
+                game.reset(static_cast<std::uint32_t>(i));
+                buffer.clear();
+            }
+
+            buffer.advance(game, static_cast<Action>(1 + mt() % 4));
+
+            long frame = buffer.get_next_frame() - frames;
+            if (buffer.has_frame(frame)){
+                buffer.set_action(frame, static_cast<Action>(1 + mt() % 4));
+                buffer.resimulate(game, frame);
+            }
+            do_not_optimize(game.get_block_info());
+        }));
+    }
+}
+
+/**
+ * the bot playing for itself, once on a single thread and once on every core,
+ * with and without its score cache.
+*/
+void bench_bot() {
+    std::vector<int> threadCounts{ 1 };
+    if (std::thread::hardware_concurrency() > 1){
+        threadCounts.push_back(static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    for (int threadCount : threadCounts){
+        for (std::size_t tableEntries : { BOT_TABLE_ENTRIES, std::size_t{ 0 } }){
+            TetrisBot bot{ threadCount, BotWeights{}, tableEntries };
+            TetrisGame game{ 1 };
+            auto start = BenchClock::now();
+
+            for (int i = 0; i < BENCH_BOT_PIECES; ++i){
+                if (game.is_game_over()){
+                    game.reset(static_cast<std::uint32_t>(i));
+                    bot.reset();
+                }
+
+                bot.play_piece(game);
+            }
+
+            std::string name = "bot/threads=" + std::to_string(threadCount) + (tableEntries == 0 ? "/no-table" : "");
+            report(name, "pieces/s", BENCH_BOT_PIECES / seconds_since(start));
+        }
+    }
+}
+
+/**
+ * the features of the board a landed block makes, as the bot scores a candidate: built
+ * and scanned, or read off the features the board keeps.
+*/
+void bench_features() {
+    TetrisMap tetrisMap;
+    fill_board(tetrisMap);
+
+    // landed blocks that complete no line, those the bot scores without building the board.
+    constexpr int BLOCK_COUNT = 32;
+    std::vector<BlockInfo> blocks;
+    for (int i = 0; blocks.size() < BLOCK_COUNT; ++i){
+        BlockInfo blockInfo = ghost_block_info(tetrisMap, BlockInfo{ static_cast<Block>(i % 7), 2, 2 + i % (TETRIS_WIDTH - 4), (i / 7) % 4 });
+        TetrisMap landed = tetrisMap;
+
+        if (landed.lock_block(blockInfo).count == 0){
+            blocks.push_back(blockInfo);
+        }
+    }
+
+    report("features/scan", "ns/op", bench_ns_per_op(BENCH_ITERATIONS / 10, [&](long i) {
+        TetrisMap landed = tetrisMap;
+        landed.lock_block(blocks[i & (BLOCK_COUNT - 1)]);
+        do_not_optimize(compute_board_features(landed));
+    }));
+
+    report("features/incremental", "ns/op", bench_ns_per_op(BENCH_ITERATIONS, [&](long i) {
+        do_not_optimize(tetrisMap.get_features_with(blocks[i & (BLOCK_COUNT - 1)]));
+    }));
+}
+
+int main() {
+    bench_block_info_visitors();
+    bench_moves();
+    bench_eliminate_lines();
+    bench_random_gen_current_block();
+    bench_render();
+    bench_raster();
+    bench_games();
+    bench_sessions();
+    bench_env();
+    bench_garbage();
+    bench_rollback();
+    bench_features();
+    bench_bot();
+
+    bench_c_run();
+
+    print_json_report(std::cout);
+}
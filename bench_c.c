@@ -0,0 +1,231 @@
+/**
+ * benchmarks of the C version, tetris.c is compiled right into this file
+ * so its static functions can be measured as they are.
+*/
+
+#define TETRIS_NO_MAIN
+#include "tetris.c"
+#include "bench_c.h"
+
+#define BENCH_ITERATIONS   2000000L
+#define BENCH_GAMES        2000
+#define BENCH_RENDERS      2000
+
+static volatile int benchSink;
+
+static double bench_seconds_since(Uint64 start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+static Uint32 bench_next_random(Uint32* state) {
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 16;
+}
+
+static void bench_reset(TetrisContext* context, unsigned int seed) {
+    reset_tetris_map(context, seed);
+}
+
+static void bench_set_cell(TetrisContext* context, int row, int col, Block block) {
+    context->data[row][col] = block;
+    context->rows[row] |= (Uint16)(1u << col);
+}
+
+/**
+ * the lower 2 / 3 of the board gets scattered blocks, every row keeps at least one hole.
+*/
+static void bench_fill_board(TetrisContext* context) {
+    Uint32 state = 1;
+    int r, c;
+
+    for (r = TETRIS_ALL_HEIGHT / 3; r < TETRIS_ALL_HEIGHT; ++r){
+        for (c = 0; c < TETRIS_WIDTH; ++c){
+            if (c != r % TETRIS_WIDTH && bench_next_random(&state) % 4 != 0){
+                bench_set_cell(context, r, c, (Block)(bench_next_random(&state) % 7));
+            }
+        }
+    }
+}
+
+static void bench_collision(TetrisContext* context) {
+    Uint64 start;
+    long i;
+    int hits = 0;
+
+    bench_reset(context, 1);
+    bench_fill_board(context);
+    context->currentBlockPos.row = TETRIS_ALL_HEIGHT / 3;
+
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < BENCH_ITERATIONS; ++i){
+        context->currentBlock = (Block)(i % 7);
+        context->currentBlockRotateTimes = (int)(i & 3);
+        context->currentBlockPos.col = (int)(i & (TETRIS_WIDTH - 1));
+        hits += check_collision(context);
+    }
+
+    benchSink = hits;
+    bench_report("check_collision", "ns/op", bench_seconds_since(start) * 1e9 / BENCH_ITERATIONS);
+}
+
+/**
+ * every iteration rebuilds 4 full rows under a half-filled board and clears them.
+*/
+static void bench_eliminate_lines(TetrisContext* context) {
+    TetrisContext board;
+    Uint64 start;
+    double copySeconds;
+    long i;
+    int r, c, clearedRows[4], cleared = 0;
+    long iterations = BENCH_ITERATIONS / 10;
+
+    bench_reset(&board, 1);
+    bench_fill_board(&board);
+    for (r = TETRIS_ALL_HEIGHT - 4; r < TETRIS_ALL_HEIGHT; ++r){
+        for (c = 0; c < TETRIS_WIDTH; ++c){
+            bench_set_cell(&board, r, c, BLOCK_I);
+        }
+    }
+
+    /* a vertical I in the rightmost column, exactly over the 4 full rows. */
+    board.currentBlock = BLOCK_I;
+    board.currentBlockRotateTimes = 1;
+    board.currentBlockPos.row = TETRIS_ALL_HEIGHT - 3;
+    board.currentBlockPos.col = TETRIS_WIDTH - 1;
+
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < iterations; ++i){
+        *context = board;
+    }
+    copySeconds = bench_seconds_since(start);
+
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < iterations; ++i){
+        *context = board;
+        cleared += eliminate_lines(context, clearedRows);
+    }
+
+    benchSink = cleared;
+    bench_report("eliminate_lines/4_lines", "ns/op", (bench_seconds_since(start) - copySeconds) * 1e9 / iterations);
+}
+
+static void bench_gen_random_block(TetrisContext* context) {
+    Uint64 start;
+    long i;
+
+    srand(1);
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < BENCH_ITERATIONS; ++i){
+        gen_random_block(context);
+    }
+
+    benchSink = context->currentBlock;
+    bench_report("gen_random_block", "ns/op", bench_seconds_since(start) * 1e9 / BENCH_ITERATIONS);
+}
+
+static void bench_render(TetrisContext* context) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    Uint64 start;
+    int i, r, c;
+    const Pos* shape;
+
+    if (surface == NULL){
+        return;
+    }
+
+    context->renderer = SDL_CreateSoftwareRenderer(surface);
+    if (context->renderer == NULL){
+        SDL_FreeSurface(surface);
+        return;
+    }
+
+    bench_reset(context, 1);
+    bench_fill_board(context);
+
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < BENCH_RENDERS; ++i){
+        render(context);
+    }
+
+    bench_report("render/offscreen", "us/frame", bench_seconds_since(start) * 1e6 / BENCH_RENDERS);
+
+    /* baseline: the same frame drawn cell by cell with render_block(). */
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < BENCH_RENDERS; ++i){
+        SDL_SetRenderDrawColor(context->renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
+        SDL_RenderClear(context->renderer);
+
+        for (r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
+            for (c = 0; c < TETRIS_WIDTH; ++c){
+                if (context->data[r][c] != BLOCK_EMPTY){
+                    render_block(context, r, c, &(blockColorMap[context->data[r][c]]));
+                }
+            }
+        }
+
+        shape = blockShapeMap[context->currentBlock][context->currentBlockRotateTimes];
+        for (c = 0; c < 4; ++c){
+            render_block(context, context->currentBlockPos.row + shape[c].row, context->currentBlockPos.col + shape[c].col,
+                         &(blockColorMap[context->currentBlock]));
+        }
+
+        SDL_RenderPresent(context->renderer);
+    }
+
+    bench_report("render/offscreen-per-cell", "us/frame", bench_seconds_since(start) * 1e6 / BENCH_RENDERS);
+
+    SDL_DestroyRenderer(context->renderer);
+    context->renderer = NULL;
+    SDL_FreeSurface(surface);
+}
+
+/**
+ * whole games with uniformly random moves, until game over.
+*/
+static void bench_games(TetrisContext* context) {
+    Uint32 state = 7;
+    long moves = 0;
+    Uint64 start;
+    double seconds;
+    int g;
+
+    start = SDL_GetPerformanceCounter();
+    for (g = 0; g < BENCH_GAMES; ++g){
+        bench_reset(context, (unsigned int)g);
+
+        while (!context->gameOver){
+            switch (bench_next_random(&state) % 4){
+                case 0:
+                    move_left(context);
+                    break;
+                case 1:
+                    move_right(context);
+                    break;
+                case 2:
+                    rotate(context);
+                    break;
+                default:
+                    move_down(context);
+                    break;
+            }
+
+            ++moves;
+        }
+    }
+
+    seconds = bench_seconds_since(start);
+    bench_report("games", "games/s", BENCH_GAMES / seconds);
+    bench_report("moves", "moves/s", moves / seconds);
+}
+
+void bench_c_run(void) {
+    static TetrisContext context;
+
+    init_piece_mask_map();
+
+    bench_collision(&context);
+    bench_eliminate_lines(&context);
+    bench_gen_random_block(&context);
+    bench_render(&context);
+    bench_games(&context);
+}
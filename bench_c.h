@@ -0,0 +1,23 @@
+#ifndef BENCH_C_H
+#define BENCH_C_H
+
+/**
+ * glue between bench.cpp, which owns the report, and bench_c.c, which
+ * measures the C version of the game.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* implemented by bench.cpp, records one result of the "c" suite. */
+void bench_report(const char* name, const char* unit, double value);
+
+/* implemented by bench_c.c, runs every benchmark of the C version. */
+void bench_c_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,15 +1,23 @@
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <SDL2/SDL.h>
 
 #undef main
 
-#define FRAME_RATE                      60
-#define FRAME_DELAY_MILLISEC            (1000 / FRAME_RATE)
 #define BLOCK_AUTO_MOVE_DOWN_MILLISEC   500
 
+/**
+ * the board size is fixed at compile time, build with e.g. -DTETRIS_WIDTH=10 -DTETRIS_HEIGHT=20
+ * for another one: 5 to 64 columns, and 4 to 60 rows.
+*/
+#ifndef TETRIS_WIDTH
 #define TETRIS_WIDTH         16
+#endif
+
+#ifndef TETRIS_HEIGHT
 #define TETRIS_HEIGHT        28
+#endif
 
 /**
  * under normal circumstances, players want a part of the block to appear 
@@ -21,6 +29,18 @@
 #define TETRIS_EXTRA_HEIGHT  4
 
 #define TETRIS_ALL_HEIGHT    (TETRIS_HEIGHT + TETRIS_EXTRA_HEIGHT)
+
+/**
+ * the same bounds as BasicTetrisMap's: a block spawns around TETRIS_WIDTH / 2 and needs
+ * room to turn, and a row of 64 bits is the widest word there is.
+*/
+#if TETRIS_WIDTH < 5 || TETRIS_WIDTH > 64
+#error "TETRIS_WIDTH must be between 5 and 64"
+#endif
+
+#if TETRIS_HEIGHT < 4 || TETRIS_ALL_HEIGHT > 64
+#error "TETRIS_HEIGHT must be between 4 and 60"
+#endif
 #define BLOCK_WIDTH          20
 
 #define WINDOW_TITLE   "Tetris"
@@ -42,13 +62,53 @@ typedef struct Pos {
     int row, col;
 } Pos;
 
+/**
+ * rows below the floor are kept as full rows, so a block that goes through
+ * the bottom collides with them like with any other block.
+ * 4 rows are enough for the tallest block (I) to sink completely.
+*/
+#define TETRIS_FLOOR_ROWS    4
+
+/**
+ * one board row in the narrowest word that holds TETRIS_WIDTH cells, bit c is column c.
+*/
+#if TETRIS_WIDTH <= 16
+typedef Uint16 RowBits;
+#elif TETRIS_WIDTH <= 32
+typedef Uint32 RowBits;
+#else
+typedef Uint64 RowBits;
+#endif
+
+#define TETRIS_FULL_ROW      ((RowBits)(((Uint64)2 << (TETRIS_WIDTH - 1)) - 1))
+
+/**
+ * column offsets in blockShapeMap lie in [-2, 2], and a block is never more than one
+ * column past its last legal position, so its column always lies in [-2, TETRIS_WIDTH + 1].
+*/
+#define PIECE_MASK_COL_OFFSET  2
+#define PIECE_MASK_COLS        (TETRIS_WIDTH + 2 * PIECE_MASK_COL_OFFSET)
+
+/**
+ * a block at one rotation and one column, already shifted into row words.
+ * rows[i] is what the block occupies in board row (pos.row + top + i).
+ * inBounds is 0 when any cell falls outside the left / right border at this column.
+*/
+typedef struct PieceMask {
+    RowBits rows[4];
+    int top;
+    int inBounds;
+} PieceMask;
+
 typedef struct TetrisContext {
     SDL_Window* window;
     SDL_Renderer* renderer;
     Block data[TETRIS_ALL_HEIGHT][TETRIS_WIDTH];
+    RowBits rows[TETRIS_ALL_HEIGHT + TETRIS_FLOOR_ROWS];   /* occupancy bits of data, bit c is column c. */
     Block currentBlock;
     Pos currentBlockPos;
     int currentBlockRotateTimes;
+    int linesCleared;
     int gameOver;
 } TetrisContext;
 
@@ -135,6 +195,48 @@ static const SDL_Color blockColorMap[] = {
 	{ 128,   0, 128, 255 } 
 };
 
+static PieceMask pieceMaskMap[7][4][PIECE_MASK_COLS];
+
+/**
+ * fill pieceMaskMap from blockShapeMap, must be called once before the first collision check.
+*/
+static void init_piece_mask_map(void) {
+    int b, rot, c, i, top, cellCol;
+    const Pos* shape;
+    PieceMask* mask;
+
+    for (b = 0; b < 7; ++b){
+        for (rot = 0; rot < 4; ++rot){
+            shape = blockShapeMap[b][rot];
+
+            top = shape[0].row;
+            for (i = 1; i < 4; ++i){
+                if (shape[i].row < top){
+                    top = shape[i].row;
+                }
+            }
+
+            for (c = 0; c < PIECE_MASK_COLS; ++c){
+                mask = &(pieceMaskMap[b][rot][c]);
+                mask->rows[0] = mask->rows[1] = mask->rows[2] = mask->rows[3] = 0;
+                mask->top = top;
+                mask->inBounds = 1;
+
+                for (i = 0; i < 4; ++i){
+                    cellCol = c - PIECE_MASK_COL_OFFSET + shape[i].col;
+
+                    if (cellCol < 0 || cellCol >= TETRIS_WIDTH){
+                        mask->inBounds = 0;
+                    }
+                    else {
+                        mask->rows[shape[i].row - top] |= (RowBits)((RowBits)1 << cellCol);
+                    }
+                }
+            }
+        }
+    }
+}
+
 static void gen_random_block(TetrisContext* context) {
     context->currentBlock = rand() % 7;                /* 7 kind of blocks: I, O, T, S, Z, J, L. */
     context->currentBlockRotateTimes = rand() % 4;     /* 4 rotations: 0, 1, 2, 3, present 0, 90, 180, 270 degrees. */
@@ -149,21 +251,32 @@ static void gen_random_block(TetrisContext* context) {
     context->currentBlockPos.row = 2;
 }
 
-static void reset_tetris_map(TetrisContext* context) {
-    srand(time(NULL));
+/**
+ * the seed decides the whole block sequence, so the same seed and the same keys
+ * always play the same game.
+*/
+static void reset_tetris_map(TetrisContext* context, unsigned int seed) {
+    srand(seed);
 
     int r, c;
     for (r = 0; r < TETRIS_ALL_HEIGHT; ++r){
         for (c = 0; c < TETRIS_WIDTH; ++c){
             context->data[r][c] = BLOCK_EMPTY;
         }
+
+        context->rows[r] = 0;
+    }
+
+    for (r = TETRIS_ALL_HEIGHT; r < TETRIS_ALL_HEIGHT + TETRIS_FLOOR_ROWS; ++r){
+        context->rows[r] = TETRIS_FULL_ROW;
     }
 
     gen_random_block(context);
+    context->linesCleared = 0;
     context->gameOver = 0;
 }
 
-static int init_tetris_context(TetrisContext* context) {
+static int init_tetris_context(TetrisContext* context, unsigned int seed) {
     if (SDL_Init(SDL_INIT_VIDEO) < 0){
 		SDL_Log("SDL_Init() failed: %s\n", SDL_GetError());
 		return 0;
@@ -187,7 +300,9 @@ static int init_tetris_context(TetrisContext* context) {
 		return 0;
 	}
 
-    reset_tetris_map(context);
+    init_piece_mask_map();
+    reset_tetris_map(context, seed);
+    SDL_Log("seed: %u\n", seed);
 	return 1;
 }
 
@@ -203,65 +318,30 @@ static void free_tetris_context(TetrisContext* context) {
     SDL_Quit();
 }
 
-#define macro_check_line_if(tetrisContextPtr, row, condition)   \
-do {                                                            \
-    Block block;                                                \
-    int c;                                                      \
-    for (c = 0; c < TETRIS_WIDTH; ++c){                         \
-        block = tetrisContextPtr->data[(row)][c];               \
-        if (!(condition)) {                                     \
-            return 0;                                           \
-        }                                                       \
-    }                                                           \
-                                                                \
-    return 1;                                                   \
-} while(0)
-
 static int check_row_is_full(TetrisContext* context, int row) {
-    macro_check_line_if(context, row, block != BLOCK_EMPTY);
+    return context->rows[row] == TETRIS_FULL_ROW;
 }
 
 static int check_row_is_empty(TetrisContext* context, int row) {
-    macro_check_line_if(context, row, block == BLOCK_EMPTY);
-}
-
-#define macro_check_collision(context, outOfBoundCondition)                                      \
-do {                                                                                             \
-    const Pos* shape = blockShapeMap[context->currentBlock][context->currentBlockRotateTimes];   \
-                                                                                                 \
-    int i, r, c;                                                                                 \
-    for (i = 0; i < 4; ++i){                                                                     \
-        r = context->currentBlockPos.row + shape[i].row;                                         \
-        c = context->currentBlockPos.col + shape[i].col;                                         \
-                                                                                                 \
-        if ((outOfBoundCondition) || context->data[r][c] != BLOCK_EMPTY) {                       \
-            return 1;                                                                            \
-        }                                                                                        \
-    }                                                                                            \
-                                                                                                 \
-    return 0;                                                                                    \
-} while(0)
-
-static int check_left_collision(TetrisContext* context) {
-    macro_check_collision(context, c < 0);
+    return context->rows[row] == 0;
 }
 
-static int check_right_collision(TetrisContext* context) {
-    macro_check_collision(context, c >= TETRIS_WIDTH);
-}
-
-static int check_down_collision(TetrisContext* context) {
-    macro_check_collision(context, r >= TETRIS_ALL_HEIGHT);
-}
+/**
+ * 4 ANDs against the precomputed mask: borders are encoded in pieceMaskMap,
+ * the floor in the full rows below TETRIS_ALL_HEIGHT.
+*/
+static int check_collision(TetrisContext* context) {
+    const PieceMask* mask = &(pieceMaskMap[context->currentBlock][context->currentBlockRotateTimes][context->currentBlockPos.col + PIECE_MASK_COL_OFFSET]);
+    const RowBits* r = context->rows + context->currentBlockPos.row + mask->top;
 
-static int check_left_right_down_collision(TetrisContext* context) {
-    macro_check_collision(context, (c < 0) || (c >= TETRIS_WIDTH) || (r >= TETRIS_ALL_HEIGHT));
+    return !mask->inBounds
+        || ((r[0] & mask->rows[0]) | (r[1] & mask->rows[1]) | (r[2] & mask->rows[2]) | (r[3] & mask->rows[3])) != 0;
 }
 
 static void move_left(TetrisContext* context) {
     context->currentBlockPos.col -= 1;
 
-    if (check_left_collision(context)){
+    if (check_collision(context)){
         context->currentBlockPos.col += 1;
     }
 }
@@ -269,7 +349,7 @@ static void move_left(TetrisContext* context) {
 static void move_right(TetrisContext* context) {
     context->currentBlockPos.col += 1;
 
-    if (check_right_collision(context)){
+    if (check_collision(context)){
         context->currentBlockPos.col -= 1;
     }
 }
@@ -283,65 +363,74 @@ static void save_current_block(TetrisContext* context) {
         c = context->currentBlockPos.col + shape[i].col;
 
         context->data[r][c] = context->currentBlock;
+        context->rows[r] |= (RowBits)((RowBits)1 << c);
     }
 }
 
+static void copy_row_to_row(TetrisContext* context, int fromRow, int toRow) {
+    memcpy(context->data[toRow], context->data[fromRow], sizeof(context->data[toRow]));
+    context->rows[toRow] = context->rows[fromRow];
+}
+
 /**
- * search the bottom empty line.
- * In most cases, players will be stuck in a situation where there are 
- * half of the blocks on the screen, so search from the middle line will be faster.
+ * remove the full rows among the rows of the block that just landed, no other row
+ * can have become full. returns how many lines went, their row indices (bottom up,
+ * as numbered before compaction) are written to clearedRows.
+ *
+ * the board is compacted in a single pass from the lowest full row upwards: every
+ * surviving row is copied at most once, straight to its final place. the pass stops
+ * at the first empty row, since nothing can float above an empty row.
 */
-static int find_the_bottom_empty_line(TetrisContext* context) {
-    int bottomEmptyLine = TETRIS_ALL_HEIGHT / 2;
-    int r;
-
-    /* if middle line is empty, search down. */
-    if (check_row_is_empty(context, bottomEmptyLine)){
-        for (r = bottomEmptyLine + 1; r < TETRIS_ALL_HEIGHT; ++r){
-            if (check_row_is_empty(context, r)){
-                bottomEmptyLine = r;
-            }
+static int eliminate_lines(TetrisContext* context, int clearedRows[4]) {
+    const PieceMask* mask = &(pieceMaskMap[context->currentBlock][context->currentBlockRotateTimes][context->currentBlockPos.col + PIECE_MASK_COL_OFFSET]);
+    int topRow = context->currentBlockPos.row + mask->top;
+    int count = 0, nextCleared = 1;
+    int r, c, fromRow, toRow;
+
+    for (r = topRow + 3; r >= topRow; --r){
+        if (r < TETRIS_ALL_HEIGHT && check_row_is_full(context, r)){
+            clearedRows[count++] = r;
         }
     }
-    else {   /* else, search up. */
-        for (r = bottomEmptyLine - 1; r >= TETRIS_EXTRA_HEIGHT; --r){
-            if (check_row_is_empty(context, r)){
-                bottomEmptyLine = r;
-            }
-        }
+
+    if (count == 0){
+        return 0;
     }
 
-    return bottomEmptyLine;
-}
+    toRow = clearedRows[0];
 
-static void eliminate_lines(TetrisContext* context) {
-    int bottomEmptyLine = find_the_bottom_empty_line(context);
-    int r, rr, c;
-    
-    for(r = TETRIS_ALL_HEIGHT - 1; r > bottomEmptyLine; ){
-        if (check_row_is_full(context, r)){
-            /* scroll down to eliminate lines. */
-            for (rr = r - 1; rr >= bottomEmptyLine; --rr){
-                for (c = 0; c < TETRIS_WIDTH; ++c) {
-                    context->data[rr + 1][c] = context->data[rr][c];
-                }
-            }
+    for (fromRow = toRow - 1; fromRow >= 0 && !check_row_is_empty(context, fromRow); --fromRow){
+        if (nextCleared < count && fromRow == clearedRows[nextCleared]){
+            ++nextCleared;
         }
         else {
-            /* if this line is not full, then search up. */
-            --r;
+            copy_row_to_row(context, fromRow, toRow);
+            --toRow;
+        }
+    }
+
+    /* rows above fromRow are already empty, the ones left between are stale copies. */
+    for (; toRow > fromRow; --toRow){
+        for (c = 0; c < TETRIS_WIDTH; ++c){
+            context->data[toRow][c] = BLOCK_EMPTY;
         }
+
+        context->rows[toRow] = 0;
     }
+
+    return count;
 }
 
 static void move_down(TetrisContext* context) {
+    int clearedRows[4];
+
     context->currentBlockPos.row += 1;
 
-    if (check_down_collision(context)){
+    if (check_collision(context)){
         context->currentBlockPos.row -= 1;
 
-        save_current_block(context);       
-        eliminate_lines(context);
+        save_current_block(context);
+        context->linesCleared += eliminate_lines(context, clearedRows);
 
         /* if TETRIS_EXTRA_HEIGHT row has any blocks, then game over. */
         if (!check_row_is_empty(context, TETRIS_EXTRA_HEIGHT)){
@@ -356,25 +445,76 @@ static void rotate(TetrisContext* context) {
     int* rotateTimes = &(context->currentBlockRotateTimes);
     *rotateTimes = (*rotateTimes + 1) % 4;
 
-    if (check_left_right_down_collision(context)){
+    if (check_collision(context)){
         *rotateTimes = (*rotateTimes + 3) % 4;
     }
 }
 
 /**
- * timer callback function.
- * it will let the current block move down in every BLOCK_AUTO_MOVE_DOWN_MILLISEC. 
- * 
- * But be careful here, cause SDL's timer is multi-threaded, so if we deal with the tetrisContext
- * here, maybe we will touch the race-condition, so a better solution is, push a SDL_USEREVENT, 
- * then in the main event loop, we can handle this event in a single thread.
+ * fixed-timestep clock for gravity, driven by SDL_GetPerformanceCounter() from the main loop.
+ * fixed_step_clock_advance() returns how many gravity steps are due, so the game only
+ * depends on elapsed time, never on the frame rate.
+ *
+ * simulated time runs timeScale times as fast as real time. an unthrottled clock ignores
+ * real time: every advance is exactly one step.
 */
-Uint32 move_down_timer_callback(Uint32 interval, void* param) {
-    SDL_Event event;
-    event.type = SDL_USEREVENT;
-    SDL_PushEvent(&event);
+#define MAX_CATCH_UP_STEPS  8   /* after a stall, the rest of it is dropped rather than replayed at once. */
+
+typedef struct FixedStepClock {
+    Uint64 startCount;
+    Uint64 stepTicks;       /* counter ticks per step at 1x. */
+    Uint64 skippedTicks;    /* simulated time given up after stalls. */
+    Uint64 steps;
+    double timeScale;
+    int unthrottled;
+} FixedStepClock;
+
+static void fixed_step_clock_start(FixedStepClock* clock, Uint32 stepMillisec, double timeScale, int unthrottled) {
+    clock->stepTicks = SDL_GetPerformanceFrequency() * stepMillisec / 1000;
+    if (clock->stepTicks == 0){
+        clock->stepTicks = 1;
+    }
+
+    clock->timeScale = timeScale > 0 ? timeScale : 1.0;
+    clock->unthrottled = unthrottled;
+    clock->skippedTicks = 0;
+    clock->steps = 0;
+    clock->startCount = SDL_GetPerformanceCounter();
+}
+
+static int fixed_step_clock_advance(FixedStepClock* clock) {
+    Uint64 simulatedTicks, due;
+
+    if (clock->unthrottled){
+        ++clock->steps;
+        return 1;
+    }
 
-    return interval;
+    /* scale the whole elapsed time rather than each frame, so rounding never drifts. */
+    simulatedTicks = (Uint64)((double)(SDL_GetPerformanceCounter() - clock->startCount) * clock->timeScale) - clock->skippedTicks;
+    due = simulatedTicks / clock->stepTicks - clock->steps;
+
+    if (due > MAX_CATCH_UP_STEPS){
+        clock->skippedTicks += (due - MAX_CATCH_UP_STEPS) * clock->stepTicks;
+        due = MAX_CATCH_UP_STEPS;
+    }
+
+    clock->steps += due;
+    return (int)due;
+}
+
+/* how long until fixed_step_clock_advance() returns a step again, rounded up so the wait never ends early. */
+static int fixed_step_clock_millisec_until_next_step(const FixedStepClock* clock) {
+    double realTarget, remaining;
+
+    if (clock->unthrottled){
+        return 0;
+    }
+
+    realTarget = (double)clock->startCount + (double)((clock->steps + 1) * clock->stepTicks + clock->skippedTicks) / clock->timeScale;
+    remaining = realTarget - (double)SDL_GetPerformanceCounter();
+
+    return remaining > 0 ? (int)(remaining * 1000 / (double)SDL_GetPerformanceFrequency()) + 1 : 0;
 }
 
 void render_block(TetrisContext* context, int row, int col, const SDL_Color* color) {
@@ -389,8 +529,65 @@ void render_block(TetrisContext* context, int row, int col, const SDL_Color* col
     SDL_RenderDrawRect(context->renderer, &rect);
 }
 
+/**
+ * a frame is drawn in batches: the cells are collected first, then filled with one
+ * SDL_RenderFillRects() per colour and outlined with a single SDL_RenderDrawRects().
+ * cells never overlap, so it looks the same as render_block() on every cell.
+*/
+#define MAX_RENDER_CELLS  (TETRIS_HEIGHT * TETRIS_WIDTH + 4)   /* the visible board plus the current block. */
+
+static SDL_Rect renderCells[MAX_RENDER_CELLS];
+static Block renderCellBlocks[MAX_RENDER_CELLS];
+static SDL_Rect renderCellsByColor[MAX_RENDER_CELLS];
+
+static void add_render_cell(int* cellCount, int row, int col, Block block) {
+    SDL_Rect rect = { col * BLOCK_WIDTH, (row - TETRIS_EXTRA_HEIGHT) * BLOCK_WIDTH, BLOCK_WIDTH, BLOCK_WIDTH };
+
+    renderCells[*cellCount] = rect;
+    renderCellBlocks[*cellCount] = block;
+    ++(*cellCount);
+}
+
+/* a counting sort groups the cells by colour, then each colour is one call. */
+static void flush_render_cells(TetrisContext* context, int cellCount) {
+    int colorStarts[BLOCK_EMPTY + 1] = { 0 };
+    int next[BLOCK_EMPTY];
+    int i, color, count;
+    const SDL_Color* fill;
+
+    for (i = 0; i < cellCount; ++i){
+        ++colorStarts[renderCellBlocks[i] + 1];
+    }
+
+    for (color = 0; color < BLOCK_EMPTY; ++color){
+        colorStarts[color + 1] += colorStarts[color];
+        next[color] = colorStarts[color];
+    }
+
+    for (i = 0; i < cellCount; ++i){
+        renderCellsByColor[next[renderCellBlocks[i]]++] = renderCells[i];
+    }
+
+    for (color = 0; color < BLOCK_EMPTY; ++color){
+        count = colorStarts[color + 1] - colorStarts[color];
+
+        if (count > 0){
+            fill = &(blockColorMap[color]);
+            SDL_SetRenderDrawColor(context->renderer, fill->r, fill->g, fill->b, fill->a);
+            SDL_RenderFillRects(context->renderer, renderCellsByColor + colorStarts[color], count);
+        }
+    }
+
+    if (cellCount > 0){
+        SDL_SetRenderDrawColor(context->renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
+        SDL_RenderDrawRects(context->renderer, renderCells, cellCount);
+    }
+}
+
 void render(TetrisContext* context) {
     int i, r, c, rotateTimes;
+    int cellCount = 0;
+    RowBits row;
     Block block;
     const Pos* shape;
 
@@ -398,18 +595,16 @@ void render(TetrisContext* context) {
     SDL_SetRenderDrawColor(context->renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
     SDL_RenderClear(context->renderer);
 
-    /* render the old blocks. */
+    /* the old blocks, only the occupied cells of each row are visited. */
     for (r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
-        for (c = 0; c < TETRIS_WIDTH; ++c){
-            block = context->data[r][c];
-
-            if (block != BLOCK_EMPTY){
-                render_block(context, r, c, &(blockColorMap[block]));
+        for (c = 0, row = context->rows[r]; row != 0; ++c, row >>= 1){
+            if (row & 1u){
+                add_render_cell(&cellCount, r, c, context->data[r][c]);
             }
         }
     }
 
-    /* render the current block. */
+    /* the current block. */
     block = context->currentBlock;
     rotateTimes = context->currentBlockRotateTimes;
     shape = blockShapeMap[block][rotateTimes];
@@ -417,36 +612,69 @@ void render(TetrisContext* context) {
     for (i = 0; i < 4; ++i){
         r = context->currentBlockPos.row + shape[i].row;
         c = context->currentBlockPos.col + shape[i].col;
-        render_block(context, r, c, &(blockColorMap[block]));
+        add_render_cell(&cellCount, r, c, block);
     }
 
+    flush_render_cells(context, cellCount);
     SDL_RenderPresent(context->renderer);
 }
 
-int main() {
+/**
+ * define TETRIS_NO_MAIN to pull the game logic into another program (see bench_c.c).
+ *
+ * usage: tetris [--seed N] [--speed X] [--unthrottled]
+ * without --seed the game is seeded from the clock, the seed is logged either way.
+ * --speed runs gravity X times as fast as real time, --unthrottled one step every frame
+ * with no frame delay.
+*/
+#ifndef TETRIS_NO_MAIN
+int main(int argc, char* argv[]) {
     TetrisContext context;
-    Uint32 startTime, endTime, frameTime;
     int running = 1;
+    int changed = 1;
     SDL_Event event;
-    SDL_TimerID moveDownTimer;
+    FixedStepClock gravityClock;
+    unsigned int seed = (unsigned int)time(NULL);
+    double speed = 1.0;
+    int unthrottled = 0;
+    int i, gravitySteps, hasEvent;
+
+    for (i = 1; i < argc; ++i){
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc){
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc){
+            speed = strtod(argv[++i], NULL);
+        }
+        else if (strcmp(argv[i], "--unthrottled") == 0){
+            unthrottled = 1;
+        }
+    }
 
-    if (!init_tetris_context(&context)){
+    if (!init_tetris_context(&context, seed)){
         goto finally;
     }
 
-    moveDownTimer = SDL_AddTimer(BLOCK_AUTO_MOVE_DOWN_MILLISEC, move_down_timer_callback, NULL);
+    fixed_step_clock_start(&gravityClock, BLOCK_AUTO_MOVE_DOWN_MILLISEC, speed, unthrottled);
 
+    /**
+     * the loop sleeps until a key or the next gravity step, nothing else can change
+     * the screen, and a frame is only drawn when one of them happened.
+    */
     while (running) {
-		startTime = SDL_GetTicks();
+        hasEvent = SDL_WaitEventTimeout(&event, fixed_step_clock_millisec_until_next_step(&gravityClock));
+        gravitySteps = fixed_step_clock_advance(&gravityClock);
 
-        while (SDL_PollEvent(&event)) {
+        while (hasEvent) {
             if (event.type == SDL_QUIT) {
                 running = 0;
 			}
-            else if (event.type == SDL_USEREVENT) {   /* associated with move_down_timer_callback() */
-                move_down(&context);
+            else if (event.type == SDL_WINDOWEVENT) {
+                changed = 1;
             }
             else if (event.type == SDL_KEYDOWN) {
+                changed = 1;
+
                 switch(event.key.keysym.sym) {
                     case SDLK_UP:
                         rotate(&context);
@@ -464,23 +692,26 @@ int main() {
                         break;
                 }
         	}
-        }
 
-        render(&context);
+            hasEvent = SDL_PollEvent(&event);
+        }
 
-        if (context.gameOver) {
-            running = 0;
+        for (; gravitySteps > 0 && !context.gameOver; --gravitySteps){
+            move_down(&context);
+            changed = 1;
         }
 
-		endTime = SDL_GetTicks();
-        frameTime = endTime - startTime;
+        if (changed) {
+            render(&context);
+            changed = 0;
+        }
 
-        if (frameTime < FRAME_DELAY_MILLISEC) {
-            SDL_Delay(FRAME_DELAY_MILLISEC - frameTime);
+        if (context.gameOver) {
+            running = 0;
         }
     }
 
 finally:
-    SDL_RemoveTimer(moveDownTimer);
     free_tetris_context(&context);
 }
+#endif
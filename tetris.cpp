@@ -2,342 +2,322 @@
 #include <iostream>
 #include <exception>
 #include <string>
-#include <functional>
-#include <algorithm>
 #include <random>
 #include <memory>
+#include <fstream>
+#include "tetris_core.hpp"
+#include "tetris_versus.hpp"
+#include "tetris_render.hpp"
+#include "tetris_ai.hpp"
+#include "tetris_replay.hpp"
+#include "tetris_clock.hpp"
+#include "tetris_metrics.hpp"
 
 #undef main
 
 using namespace std::string_literals;
 
+/**
+ * the loop sleeps until something happens, so there is no frame rate as such,
+ * only the pace at which the bot presses keys.
+*/
 constexpr int FRAME_RATE                    = 60;
 constexpr int FRAME_DELAY_MILLISEC          = 1000 / FRAME_RATE;
 constexpr int BLOCK_AUTO_MOVE_DOWN_MILLISEC = 500;
 
-constexpr int TETRIS_WIDTH = 16;
-constexpr int TETRIS_HEIGHT = 28;
-
-/**
- * under normal circumstances, players want a part of the block to appear 
- * from the top of the screen and then gradually appear as a whole, that's
- * why a extra height is used here.
- * 
- * 4 is the longest block: I's length, so these 4 rows could contain all kinds of blocks.
-*/
-constexpr int TETRIS_EXTRA_HEIGHT = 4;
-
-constexpr int TETRIS_ALL_HEIGHT = TETRIS_HEIGHT + TETRIS_EXTRA_HEIGHT;
-constexpr int BLOCK_WIDTH = 20;
-
 const std::string WINDOW_TITLE = "Tetris";
 constexpr int WINDOW_WIDTH = TETRIS_WIDTH * BLOCK_WIDTH;
 constexpr int WINDOW_HEIGHT = TETRIS_HEIGHT * BLOCK_WIDTH;
 
-enum Block {
-    I, O, T, S, Z, J, L, Empty
+struct TetrisOptions {
+    bool autoplay = false;
+    std::string recordPath;   // append this game to a replay file when it ends.
+    std::string replayPath;   // play the first game of a replay file instead of the keyboard.
+    double speed = 1.0;       // how much faster than real time the game runs.
+    bool unthrottled = false; // one gravity step per loop, and the loop never sleeps.
+    std::string metricsPath;  // write the frame timing histograms here on exit, CSV if it ends with .csv, JSON otherwise.
+    bool overlay = false;     // show the frame timing on screen, F3 toggles it.
+    bool raster = false;      // draw with TetrisRasterizer instead of SDL renderer calls.
+    int scale = 1;            // window size, in multiples of the board's natural size.
+    std::string connect;      // play versus on this tetris-server (host:port) instead of alone.
+    bool ghost = true;        // show where the block will land.
 };
 
-struct Pos {
-    int row, col;
-};
+class Tetris {
+    SDL_Window* window = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    TetrisGame game;
 
-constexpr SDL_Color COLOR_BLACK = { 0, 0, 0, 255 };
-
-constexpr SDL_Color blockColorMap[] = {
-  // block I RGBA.
-  {  57, 197, 187, 255 },
-  // block O.
-	{ 255, 165,   0, 255 },
-	// block T.
-	{ 255, 255,   0, 255 },
-	// block S.
-	{   0, 128,   0, 255 },
-	// block Z.
-	{ 255,   0,   0, 255 },
-	// block J.
-	{   0,   0, 255, 255 },
-	// block L.
-	{ 128,   0, 128, 255 } 
-};
+    TetrisOptions options;
 
-/**
- * (row, column)
- * 
- *      O           O           O             row axis 
- *   (0, -1)     (0, 0)      (0, 1)
- * 
- *                  O
- *               (1, 0)
- * 
- * 
- *             column  axis
-*/
-constexpr Pos blockShapeMap[][4][4] = {
-    // block I.
-    {
-        { { 0, 0 }, {  0, -1 }, {  0,  1, }, {  0,  2 } },   // 0 degrees.
-        { { 0, 0 }, { -1,  0 }, {  1,  0, }, {  2,  0 } },   // 90 degrees.
-        { { 0, 0 }, {  0,  1 }, {  0, -1, }, {  0, -2 } },   // 180 degrees.
-        { { 0, 0 }, {  1,  0 }, { -1,  0, }, { -2,  0 } },   // 270 degrees.
-    },
-    // block O.
-    {
-        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
-        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
-        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
-        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
-    },
-    // block T.
-    {
-        { { 0, 0 }, {  0, -1 }, {  0,  1 }, {  1,  0 } },
-        { { 0, 0 }, { -1,  0 }, {  1,  0 }, {  0, -1 } },
-        { { 0, 0 }, {  0,  1 }, {  0, -1 }, { -1,  0 } },
-        { { 0, 0 }, {  1,  0 }, { -1,  0 }, {  0,  1 } },
-    },
-    // block S.
-    {
-        { { -1, -1 }, {  0, -1 }, { 0, 0 }, {  1,  0 } }, 
-        { { -1,  1 }, { -1,  0 }, { 0, 0 }, {  0, -1 } }, 
-        { {  1,  1 }, {  0,  1 }, { 0, 0 }, { -1,  0 } },
-        { {  1, -1 }, {  1,  0 }, { 0, 0 }, {  0,  1 } },
-    },
-    // block Z.
-    {
-        { { -1,  0 }, { 0, 0 }, {  0, -1 }, {  1, -1 } },
-        { {  0,  1 }, { 0, 0 }, { -1,  0 }, { -1, -1 } },
-        { {  1,  0 }, { 0, 0 }, {  0,  1 }, { -1,  1 } },
-        { {  0, -1 }, { 0, 0 }, {  1,  0 }, {  1,  1 } },
-    },
-    // block J.
-    {
-        { { 0, 0 }, { -1,  0 }, { -2,  0 }, {  0, -1 } },
-        { { 0, 0 }, {  0,  1 }, {  0,  2 }, { -1,  0 } },
-        { { 0, 0 }, {  1,  0 }, {  2,  0 }, {  0,  1 } },
-        { { 0, 0 }, {  0, -1 }, {  0, -2 }, {  1,  0 } }
-    },
-    // block L.
-    {
-        { { 0, 0 }, { -1,  0 }, { -2,  0 }, {  0,  1 } }, 
-        { { 0, 0 }, {  0,  1 }, {  0,  2 }, {  1,  0 } },
-        { { 0, 0 }, {  1,  0 }, {  2,  0 }, {  0, -1 } },
-        { { 0, 0 }, {  0, -1 }, {  0, -2 }, { -1,  0 } },
-    }
-};
+    // gravity runs on simulated time, one step every BLOCK_AUTO_MOVE_DOWN_MILLISEC.
+    FixedStepClock gravityClock;
 
-class TetrisMap {
-    Block blocks[TETRIS_ALL_HEIGHT][TETRIS_WIDTH];
+    // the board is drawn incrementally into one of these, see TetrisCanvas and FramebufferCanvas.
+    std::unique_ptr<TetrisCanvas> canvas;
+    std::unique_ptr<FramebufferCanvas> framebufferCanvas;
 
-    void copy_row_to_row(int fromRow, int toRow) noexcept {
-        for (int c = 0; c < TETRIS_WIDTH; ++c){
-            blocks[toRow][c] = blocks[fromRow][c];
-        }
-    }
+    // when set, the bot plays one key per frame, the keyboard still works too.
+    std::unique_ptr<TetrisBot> bot;
+
+    // versus mode: the game runs on the server, this one only shows it.
+    std::unique_ptr<VersusClient> versus;
+    Uint32 versusEvent = 0;     // pushed by the client's reader thread when the server sent something.
+    std::string title;
+
+    ReplayWriter replayWriter;
+    std::vector<ReplayEvent> replayEvents;
+    std::size_t nextReplayEvent = 0;
+
+    bool replaying = false;
+    bool running = false;
+    bool exposed = false;   // the window needs its content again, changed or not.
+    Uint64 nextBotMove = 0;
+
+    // frame timing, only collected when it is dumped or shown.
+    std::unique_ptr<FrameMetrics> metrics;
+    bool showOverlay = false;
+    Uint64 logicTicks = 0;           // time spent in game.step() during this loop iteration.
+    int logicSteps = 0;
+    std::vector<Uint64> pendingKeys; // when each key handled since the last present reached SDL, in counter ticks.
 
     /**
-    * search the bottom empty line.
-    * In most cases, players will be stuck in a situation where there are 
-    * half of the blocks on the screen, so search from the middle line will be faster.
+    * every action goes through here, so a recording sees exactly what the game saw.
     */
-    int find_the_bottom_empty_line() {
-        int bottomEmptyLine = TETRIS_ALL_HEIGHT / 2;
-
-        // if middle line is empty, search down.
-        if (check_row_is_empty(bottomEmptyLine)){
-            for (int r = bottomEmptyLine + 1; r < TETRIS_ALL_HEIGHT; ++r){
-                if (check_row_is_empty(r)){
-                    bottomEmptyLine = r;
-                }
-            }
+    void apply(Action action) {
+        if (versus){
+            versus->send_input(action);
+            return;
         }
-        else {   // else, search up.
-            for (int r = bottomEmptyLine - 1; r >= TETRIS_EXTRA_HEIGHT; --r){
-                if (check_row_is_empty(r)){
-                    bottomEmptyLine = r;
-                }
-            }
+
+        if (!options.recordPath.empty()){
+            replayWriter.record(gravityClock.get_time_millisec(), action);
         }
 
-        return bottomEmptyLine;
-    }
-public:
-    TetrisMap() {
-        for (int r = 0; r < TETRIS_ALL_HEIGHT; ++r){
-            for (int c = 0; c < TETRIS_WIDTH; ++c){
-                blocks[r][c] = Block::Empty;
-            }
+        if (metrics){
+            Uint64 start = SDL_GetPerformanceCounter();
+            game.step(action);
+            logicTicks += SDL_GetPerformanceCounter() - start;
+            ++logicSteps;
+        }
+        else {
+            game.step(action);
         }
     }
 
-    Block get(int row, int col) const noexcept {
-        return blocks[row][col];
+    /**
+    * SDL stamps a key with SDL_GetTicks() when it arrives, so the time it waited in
+    * the queue is known to the millisecond, the rest is measured with the counter.
+    */
+    void note_key(SDL_KeyboardEvent const& key) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        Uint32 queuedMillisec = SDL_GetTicks() - key.timestamp;
+        pendingKeys.push_back(now - std::min<Uint64>(now, queuedMillisec * SDL_GetPerformanceFrequency() / 1000));
     }
 
-    void set(int row, int col, Block block) noexcept {
-        blocks[row][col] = block;
+    /**
+    * the keys so far have reached the screen, or had nothing to show.
+    */
+    void flush_key_latencies(Uint64 now) {
+        for (Uint64 keyTime : pendingKeys){
+            metrics->record(FrameMetrics::InputLatency, now - keyTime);
+        }
+
+        pendingKeys.clear();
     }
 
-    void render_block(SDL_Renderer* renderer, int row, int col, Block block) noexcept {
-        SDL_Color const& color = blockColorMap[static_cast<int>(block)];
-        SDL_Rect rect = { 
-            col * BLOCK_WIDTH, 
-            (row - TETRIS_EXTRA_HEIGHT) * BLOCK_WIDTH, 
-            BLOCK_WIDTH, 
-            BLOCK_WIDTH
+    /**
+    * one bar per stage, the p99 in grey behind the p50 in colour, at 10 px per millisecond.
+    * the white tick marks a 60 Hz frame, 16.7 ms.
+    */
+    void render_overlay() {
+        constexpr int MARGIN = 4;
+        constexpr int BAR_HEIGHT = 6;
+        constexpr int MICROS_PER_PIXEL = 100;
+        constexpr int MAX_BAR = WINDOW_WIDTH - 2 * MARGIN;
+
+        auto bar_width = [](std::uint64_t micros) {
+            return static_cast<int>(std::min<std::uint64_t>(micros / MICROS_PER_PIXEL, MAX_BAR));
         };
 
-        // render a filled rectangle.
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-        SDL_RenderFillRect(renderer, &rect);
-
-        // render a outlined rectangle.
-        SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
-        SDL_RenderDrawRect(renderer, &rect);
-    }
-
-    bool check_row_is_full(int rowIndex) const noexcept {
-        const auto& row = blocks[rowIndex];
-		    return std::none_of(std::cbegin(row), std::cend(row), [](Block block) { return block == Block::Empty; });
-    }
+        SDL_Rect background = { 0, 0, WINDOW_WIDTH, MARGIN + FrameMetrics::STAGE_COUNT * (BAR_HEIGHT + 2) + MARGIN };
+        SDL_SetRenderDrawColor(renderer, 32, 32, 32, 255);
+        SDL_RenderFillRect(renderer, &background);
 
-    bool check_row_is_empty(int rowIndex) const noexcept {
-        const auto& row = blocks[rowIndex];
-		    return std::all_of(std::cbegin(row), std::cend(row), [](Block block) { return block == Block::Empty; });
-    }
+        for (int stage = 0; stage < FrameMetrics::STAGE_COUNT; ++stage){
+            LatencyHistogram const& histogram = metrics->get(static_cast<FrameMetrics::Stage>(stage));
+            SDL_Color const& color = blockColorMap[stage];
+            int y = MARGIN + stage * (BAR_HEIGHT + 2);
 
-    void render(SDL_Renderer* renderer) noexcept {
-        for (int r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
-            for (int c = 0; c < TETRIS_WIDTH; ++c){
-                Block block = get(r, c);
+            SDL_Rect p99 = { MARGIN, y, bar_width(histogram.get_percentile(0.99)), BAR_HEIGHT };
+            SDL_SetRenderDrawColor(renderer, 128, 128, 128, 255);
+            SDL_RenderFillRect(renderer, &p99);
 
-                if (block != Block::Empty){
-                    render_block(renderer, r, c, block);
-                }
-            }
+            SDL_Rect p50 = { MARGIN, y, bar_width(histogram.get_percentile(0.5)), BAR_HEIGHT };
+            SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+            SDL_RenderFillRect(renderer, &p50);
         }
-    }
 
-    void eliminate_lines() noexcept {
-        int bottomEmptyLine = find_the_bottom_empty_line();
-        
-        for(int r = TETRIS_ALL_HEIGHT - 1; r > bottomEmptyLine; ){
-            if (check_row_is_full(r)){
-                // scroll down to eliminate lines.
-                for (int rr = r - 1; rr >= bottomEmptyLine; --rr){
-                    copy_row_to_row(rr, rr + 1);
-                }
-            }
-            else {
-                // if this line is not full, then search up.
-                --r;
-            }
-        }
+        SDL_Rect budget = { MARGIN + bar_width(1000000 / 60), 0, 1, background.h };
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderFillRect(renderer, &budget);
     }
-};
 
-using BlockInfoAction = std::function<void(int row, int col)>;
-using BlockInfoCond = std::function<bool(int row, int col)>;
-
-class BlockInfo {
-    Block block;
-    Pos pos;
-    int rotateTimes;
-public:
-    BlockInfo()
-        : block{ Block::Empty }, pos{ 0, 0 }, rotateTimes{ 0 }
-    {}
-
-    BlockInfo(Block _block, int row, int col, int _rotateTimes)
-        : block{ _block }, pos{ row, col }, rotateTimes{ _rotateTimes }
-    {}
+    void connect() {
+        std::size_t colon = options.connect.rfind(':');
+        if (colon == std::string::npos){
+            throw std::runtime_error{ "--connect wants host:port" };
+        }
 
-    Block get_block() const noexcept {
-        return block;
-    }
+        versusEvent = SDL_RegisterEvents(1);
+        if (versusEvent == static_cast<Uint32>(-1)){
+            throw std::runtime_error{ "SDL_RegisterEvents() failed" };
+        }
 
-    const Pos* get_shape() const noexcept {
-        return blockShapeMap[static_cast<int>(block)][rotateTimes];
+        Uint32 eventType = versusEvent;
+        versus = std::make_unique<VersusClient>(options.connect.substr(0, colon), options.connect.substr(colon + 1), [eventType] {
+            SDL_Event event{};
+            event.type = eventType;
+            SDL_PushEvent(&event);
+        });
     }
 
-    void for_each_shape_point(BlockInfoAction action) {
-        const Pos* shape = get_shape();
+    /**
+    * apply what the server sent, and show the match in the window title.
+    */
+    void receive_versus() {
+        versus->poll();
 
-        for (int i = 0; i < 4; ++i) {
-            int row = pos.row + shape[i].row;
-            int col = pos.col + shape[i].col;
+        RemoteGame const& remoteGame = versus->get_game();
+        std::string status = WINDOW_TITLE;
 
-            action(row, col);
+        if (versus->get_player_count() == 0){
+            status += " - waiting for players";
         }
-    }
+        else {
+            status += " - round " + std::to_string(remoteGame.get_round()) + ", " + std::to_string(remoteGame.get_lines_cleared()) + " lines";
 
-    bool for_each_shape_point_if(BlockInfoCond cond) const {
-        const Pos* shape = get_shape();
+            if (remoteGame.get_pending_garbage() > 0){
+                status += ", " + std::to_string(remoteGame.get_pending_garbage()) + " incoming";
+            }
 
-        for (int i = 0; i < 4; ++i) {
-            int row = pos.row + shape[i].row;
-            int col = pos.col + shape[i].col;
+            for (OpponentStatus const& opponent : remoteGame.get_opponents()){
+                status += " | P" + std::to_string(opponent.seat + 1) + " " + std::to_string(opponent.lines) + (opponent.alive ? "" : " out");
+            }
 
-            if (cond(row, col)) {
-                return true;
+            if (remoteGame.is_game_over()){
+                status += " - game over";
             }
         }
 
-        return false;
+        if (status != title){
+            title = status;
+            SDL_SetWindowTitle(window, title.c_str());
+        }
     }
 
-    void rotate() noexcept {
-        rotateTimes = (rotateTimes + 1) % 4;
-    }
+    void load_replay() {
+        ReplayFile replayFile{ options.replayPath };
+        if (replayFile.get_records().empty()){
+            throw std::runtime_error{ "empty replay: "s + options.replayPath };
+        }
 
-    void un_rotate() noexcept {
-        rotateTimes = (rotateTimes + 3) % 4;
-    }
+        ReplayRecord const& record = replayFile.get_records().front();
+        record.for_each_event([this](ReplayEvent const& event) {
+            replayEvents.push_back(event);
+        });
 
-    void go_left() noexcept {
-        pos.col -= 1;
+        game.reset(record.seed);
     }
 
-    void go_right() noexcept {
-        pos.col += 1;
-    }
+    /**
+    * feed the replay to the game at the pace it was recorded, true once it has all been played.
+    */
+    bool play_replay_until_now() {
+        Uint32 now = gravityClock.get_time_millisec();
 
-    void go_down() noexcept {
-        pos.row += 1;
-    }
+        while (nextReplayEvent < replayEvents.size() && replayEvents[nextReplayEvent].timeMillisec <= now){
+            game.step(replayEvents[nextReplayEvent++].action);
+        }
 
-    void go_top() noexcept {
-        pos.row -= 1;
+        return nextReplayEvent == replayEvents.size();
     }
-};
 
-/**
-* timer callback function.
-* it will let the current block move down in every BLOCK_AUTO_MOVE_DOWN_MILLISEC. 
-* 
-* But be careful here, cause SDL's timer is multi-threaded, so if we deal with the tetrisContext
-* here, maybe we will touch the race-condition, so a better solution is, push a SDL_USEREVENT, 
-* then in the main event loop, we can handle this event in a single thread.
-*/
-Uint32 move_down_timer_callback(Uint32 interval, void* param) {
-    SDL_Event event;
-    event.type = SDL_USEREVENT;
-    SDL_PushEvent(&event);
+    /**
+    * how long the main loop may block waiting for events: nothing happens on its own
+    * before the next gravity step, the next replay event or the bot's next move.
+    */
+    Uint32 get_wait_millisec(Uint64 now) const noexcept {
+        // the server does the waiting in versus mode, the window only wakes up for its messages.
+        if (versus){
+            return SDL_MAX_UINT32;
+        }
 
-    return interval;
-}
+        if (replaying){
+            if (nextReplayEvent >= replayEvents.size()){
+                return 0;
+            }
 
-class Tetris {
-    SDL_Window* window = nullptr;
-    SDL_Renderer* renderer = nullptr;
-    SDL_TimerID moveDownTimer;
-    TetrisMap tetrisMap;
-    BlockInfo blockInfo;
-    bool gameOver = false;
+            return gravityClock.get_millisec_until(replayEvents[nextReplayEvent].timeMillisec, now);
+        }
 
-    // random generator.
-    std::mt19937 mt{ std::random_device{}() };
-	  std::uniform_int_distribution<unsigned int> randomBlock{ 0, 6 };
-	  std::uniform_int_distribution<unsigned int> randomRotation{ 0, 3 };
+        Uint32 wait = gravityClock.get_millisec_until_next_step(now);
+
+        if (bot){
+            Uint64 botWait = nextBotMove > now ? (nextBotMove - now) * 1000 / SDL_GetPerformanceFrequency() + 1 : 0;
+            wait = std::min(wait, static_cast<Uint32>(botWait));
+        }
+
+        return wait;
+    }
+
+    void handle_event(SDL_Event const& event) {
+        if (event.type == SDL_QUIT) {
+            running = false;
+        }
+        else if (versus && event.type == versusEvent) {
+            receive_versus();
+        }
+        else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+            exposed = true;
+        }
+        else if (event.type == SDL_RENDER_TARGETS_RESET) {
+            invalidate_canvas();
+        }
+        else if (event.type == SDL_RENDER_DEVICE_RESET) {
+            create_canvas();
+            exposed = true;
+        }
+        else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3 && metrics) {
+            showOverlay = !showOverlay;
+            exposed = true;
+        }
+        else if (event.type == SDL_KEYDOWN && !replaying) {
+            if (metrics){
+                note_key(event.key);
+            }
+
+            switch(event.key.keysym.sym) {
+                case SDLK_UP:
+                    apply(Action::Rotate);
+                    break;
+                case SDLK_LEFT:
+                    apply(Action::Left);
+                    break;
+                case SDLK_RIGHT:
+                    apply(Action::Right);
+                    break;
+                case SDLK_DOWN:
+                    apply(Action::Down);
+                    break;
+                case SDLK_SPACE:
+                    apply(Action::HardDrop);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
 
     void init_graphics(){
         if (SDL_Init(SDL_INIT_VIDEO) < 0){
@@ -347,134 +327,123 @@ class Tetris {
         window = SDL_CreateWindow(WINDOW_TITLE.c_str(), 
                                     SDL_WINDOWPOS_CENTERED, 
                                     SDL_WINDOWPOS_CENTERED, 
-                                    WINDOW_WIDTH, 
-                                    WINDOW_HEIGHT, 
+                                    WINDOW_WIDTH * options.scale, 
+                                    WINDOW_HEIGHT * options.scale, 
                                     0);
                                 
         if (window == nullptr){
             throw std::runtime_error{ "create window failed: "s + SDL_GetError() };
         }
 
-        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE);
         if (renderer == nullptr){
             throw std::runtime_error{ "create renderer failed: "s + SDL_GetError() };
         }
-    }
 
-    void random_gen_current_block() {
-        // 7 kind of blocks: I, O, T, S, Z, J, L.
-        Block block = static_cast<Block>(randomBlock(mt)); 
-        
-        // 4 rotations: 0, 1, 2, 3, present 0, 90, 180, 270 degrees.
-        int rotateTimes = static_cast<int>(randomRotation(mt));  
-
-        // new block should be centered.
-        int col = TETRIS_WIDTH / 2;   
-    
-        /**
-        * Default row can't be 0. because the blockShapeMap we defined above,
-        * are based on the center point. Assuming we get a block I, and it is vertical,
-        * then on the top of the center point, there should be at least 2 blocks space.
-        * that's why the default row should be 2 here.
-        */
-        int row = 2;
-
-        blockInfo = BlockInfo{ block, row, col, rotateTimes };
+        create_canvas();
     }
 
-    void save_current_block() noexcept {
-        blockInfo.for_each_shape_point([this](int row, int col) {
-            tetrisMap.set(row, col, blockInfo.get_block());
-        });
-    }
+    /**
+    * TetrisCanvas draws at the natural size and lets SDL_RenderCopy() stretch it to the
+    * window, FramebufferCanvas rasters at the window's size directly.
+    */
+    void create_canvas() {
+        canvas.reset();
+        framebufferCanvas.reset();
 
-    bool check_left_collision() const noexcept {
-        return blockInfo.for_each_shape_point_if([this](int row, int col) {
-            return col < 0 || tetrisMap.get(row, col) != Block::Empty;
-        });
+        if (options.raster){
+            framebufferCanvas = std::make_unique<FramebufferCanvas>(renderer, options.scale);
+            framebufferCanvas->set_ghost(options.ghost);
+        }
+        else {
+            canvas = std::make_unique<TetrisCanvas>(renderer, WINDOW_WIDTH, WINDOW_HEIGHT);
+            canvas->set_ghost(options.ghost);
+        }
     }
 
-    bool check_right_collision() const noexcept {
-        return blockInfo.for_each_shape_point_if([this](int row, int col) {
-            return col >= TETRIS_WIDTH || tetrisMap.get(row, col) != Block::Empty;
-        });
+    void invalidate_canvas() noexcept {
+        if (framebufferCanvas){
+            framebufferCanvas->invalidate();
+        }
+        else {
+            canvas->invalidate();
+        }
     }
 
-    bool check_down_collision() const noexcept {
-        return blockInfo.for_each_shape_point_if([this](int row, int col) {
-            return row >= TETRIS_ALL_HEIGHT || tetrisMap.get(row, col) != Block::Empty;
-        });
+    template <typename Game>
+    bool render_game(Game& shownGame, bool force) noexcept {
+        return framebufferCanvas ? framebufferCanvas->render(shownGame, force) : canvas->render(shownGame, force);
     }
 
-    bool check_left_right_down_collision() const noexcept {
-        return blockInfo.for_each_shape_point_if([this](int row, int col) {
-            return col < 0 || col >= TETRIS_WIDTH || row >= TETRIS_ALL_HEIGHT || tetrisMap.get(row, col) != Block::Empty;
-        });
-    }
+    /**
+    * only what changed is drawn, and nothing is presented when nothing did,
+    * unless force is set because the window needs its content again.
+    */
+    void render(bool force = false){
+        Uint64 renderStart = metrics ? SDL_GetPerformanceCounter() : 0;
 
-    void move_left() noexcept {
-        blockInfo.go_left();
+        bool changed = versus ? versus->get_game().is_started() && render_game(versus->get_game(), force) : render_game(game, force);
 
-        if (check_left_collision()){
-            blockInfo.go_right();
+        if (!changed){
+            return;
         }
-    }
 
-    void move_right() noexcept {
-        blockInfo.go_right();
+        if (showOverlay){
+            render_overlay();
+        }
 
-        if (check_right_collision()){
-            blockInfo.go_left();
+        if (!metrics){
+            SDL_RenderPresent(renderer);
+            return;
         }
-    }
 
-    void move_down() noexcept {
-        blockInfo.go_down();
+        Uint64 presentStart = SDL_GetPerformanceCounter();
+        SDL_RenderPresent(renderer);
+        Uint64 presentEnd = SDL_GetPerformanceCounter();
 
-        if (check_down_collision()){
-            blockInfo.go_top();
+        metrics->record(FrameMetrics::Render, presentStart - renderStart);
+        metrics->record(FrameMetrics::Present, presentEnd - presentStart);
+        flush_key_latencies(presentEnd);
+    }
 
-            save_current_block();
-            tetrisMap.eliminate_lines();
+    void write_metrics() const {
+        std::ofstream file{ options.metricsPath };
+        bool csv = options.metricsPath.size() >= 4 && options.metricsPath.compare(options.metricsPath.size() - 4, 4, ".csv") == 0;
 
-            // if TETRIS_EXTRA_HEIGHT row has any blocks, then game over.
-            if (!tetrisMap.check_row_is_empty(TETRIS_EXTRA_HEIGHT)){
-                gameOver = true;
-            }
+        if (csv){
+            metrics->write_csv(file);
+        }
+        else {
+            metrics->write_json(file);
+        }
 
-            random_gen_current_block();
+        if (!file){
+            throw std::runtime_error{ "write metrics failed: " + options.metricsPath };
         }
     }
+public:
+    explicit Tetris(TetrisOptions _options = TetrisOptions{})
+        : options{ std::move(_options) },
+          gravityClock{ SDL_GetPerformanceFrequency(), BLOCK_AUTO_MOVE_DOWN_MILLISEC, options.speed, options.unthrottled }
+    {
+        if (options.autoplay){
+            bot = std::make_unique<TetrisBot>();
+        }
 
-    void rotate() noexcept {
-        blockInfo.rotate();
-
-        if (check_left_right_down_collision()){
-            blockInfo.un_rotate();
+        if (!options.metricsPath.empty() || options.overlay){
+            metrics = std::make_unique<FrameMetrics>(SDL_GetPerformanceFrequency());
+            showOverlay = options.overlay;
         }
     }
 
-    void render(){
-        // using black color to clear the screen first.
-        SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
-        SDL_RenderClear(renderer);
+    ~Tetris() noexcept {
+        // its reader thread pushes SDL events.
+        versus.reset();
 
-        tetrisMap.render(renderer);
+        // the canvas textures belong to the renderer, they must go first.
+        canvas.reset();
+        framebufferCanvas.reset();
 
-        blockInfo.for_each_shape_point([this] (int row, int col) {
-            tetrisMap.render_block(renderer, row, col, blockInfo.get_block());
-        });
-
-        SDL_RenderPresent(renderer);
-    }
-public:
-    Tetris() = default;
-
-    ~Tetris() noexcept {
-	if (moveDownTimer != 0){
-            SDL_RemoveTimer(moveDownTimer);
-        }
-	    
         if (renderer != nullptr){
             SDL_DestroyRenderer(renderer);
         }
@@ -487,63 +456,160 @@ public:
     }
 
     void start() {
-        random_gen_current_block();
+        replaying = !options.replayPath.empty();
+
+        if (replaying){
+            load_replay();
+        }
+        else if (options.connect.empty()){
+            std::uint32_t seed = std::random_device{}();
+            game.reset(seed);
+            replayWriter.begin(seed);
+        }
+
         init_graphics();
 
-        Uint32 startTime, endTime, frameTime;
-        bool running = true;
+        if (!options.connect.empty()){
+            connect();
+        }
+
         SDL_Event event;
-        moveDownTimer = SDL_AddTimer(BLOCK_AUTO_MOVE_DOWN_MILLISEC, move_down_timer_callback, nullptr);
+        running = true;
+        gravityClock.start(SDL_GetPerformanceCounter());
 
         while (running) {
-		    startTime = SDL_GetTicks();
+            // sleep until the next key, gravity step, replay event or bot move, whichever comes first.
+            // (SDL_MAX_UINT32 becomes -1, no timeout at all.)
+            bool hasEvent = SDL_WaitEventTimeout(&event, static_cast<int>(get_wait_millisec(SDL_GetPerformanceCounter()))) != 0;
+
+            Uint64 now = SDL_GetPerformanceCounter();
+            int gravitySteps = gravityClock.advance(now);
+            logicTicks = 0;
+            logicSteps = 0;
+
+            if (hasEvent) {
+                do {
+                    handle_event(event);
+                } while (SDL_PollEvent(&event));
+
+                if (metrics) {
+                    metrics->record(FrameMetrics::Events, SDL_GetPerformanceCounter() - now - logicTicks);
+                }
+            }
 
-            while (SDL_PollEvent(&event)) {
-                if (event.type == SDL_QUIT) {
+            // a replay carries its own gravity steps, and the server those of a versus match.
+            if (replaying) {
+                if (play_replay_until_now()) {
                     running = false;
-			          }
-                else if (event.type == SDL_USEREVENT) {   // associated with move_down_timer_callback().
-                    move_down();
                 }
-                else if (event.type == SDL_KEYDOWN) {
-                    switch(event.key.keysym.sym) {
-                        case SDLK_UP:
-                            rotate();
-                            break;
-                        case SDLK_LEFT:
-                            move_left();
-                            break;
-                        case SDLK_RIGHT:
-                            move_right();
-                            break;
-                        case SDLK_DOWN:
-                            move_down();
-                            break;
-                        default:
-                            break;
-                    }
-        	      }
             }
+            else if (!versus) {
+                if (bot && now >= nextBotMove) {
+                    apply(bot->next_action(game));
+                    nextBotMove = now + SDL_GetPerformanceFrequency() * FRAME_DELAY_MILLISEC / 1000;
+                }
 
-            render();
+                for (; gravitySteps > 0 && !game.is_game_over(); --gravitySteps) {
+                    apply(Action::Gravity);
+                }
+            }
 
-            if (gameOver) {
-                running = false;
+            if (metrics && logicSteps > 0) {
+                metrics->record(FrameMetrics::Logic, logicTicks);
             }
 
-            endTime = SDL_GetTicks();
-            frameTime = endTime - startTime;
+            render(exposed);
+            exposed = false;
 
-            if (frameTime < FRAME_DELAY_MILLISEC) {
-                SDL_Delay(FRAME_DELAY_MILLISEC - frameTime);
+            // keys that changed nothing had nothing to wait for.
+            if (metrics && !pendingKeys.empty()) {
+                flush_key_latencies(SDL_GetPerformanceCounter());
             }
+
+            // in versus mode the next round starts on its own.
+            if (game.is_game_over() && !versus) {
+                running = false;
+            }
+        }
+
+        if (!options.recordPath.empty()){
+            replayWriter.append_to_file(options.recordPath, game);
+        }
+
+        if (!options.metricsPath.empty()){
+            write_metrics();
         }
     }
 };
 
-int main(){
+/**
+ * usage: tetris [--autoplay] [--record replay-file] [--replay replay-file] [--speed X] [--unthrottled]
+ *               [--metrics file.json|file.csv] [--overlay] [--backend sdl|raster] [--scale N]
+ *               [--connect host:port] [--no-ghost]
+ *
+ * --speed runs the game (or a replay) X times as fast as real time, --unthrottled
+ * as fast as it can render. --metrics and --overlay time every loop iteration,
+ * see tetris_metrics.hpp. --backend raster draws with the software rasteriser of
+ * tetris_raster.hpp, --scale makes the window N times as large (3 fills most of a 4K screen).
+ * --connect plays versus on a tetris-server, see tetris_versus.hpp, the window title shows the score.
+ * space drops the block at once, where its ghost is drawn. --no-ghost hides the ghost.
+*/
+int main(int argc, char* argv[]){
+    TetrisOptions options;
+
     try {
-        auto tetris = std::make_unique<Tetris>();
+        for (int i = 1; i < argc; ++i){
+            bool hasValue = i + 1 < argc;
+
+            if (argv[i] == "--autoplay"s){
+                options.autoplay = true;
+            }
+            else if (argv[i] == "--record"s && hasValue){
+                options.recordPath = argv[++i];
+            }
+            else if (argv[i] == "--replay"s && hasValue){
+                options.replayPath = argv[++i];
+            }
+            else if (argv[i] == "--speed"s && hasValue){
+                options.speed = std::stod(argv[++i]);
+            }
+            else if (argv[i] == "--unthrottled"s){
+                options.unthrottled = true;
+            }
+            else if (argv[i] == "--metrics"s && hasValue){
+                options.metricsPath = argv[++i];
+            }
+            else if (argv[i] == "--overlay"s){
+                options.overlay = true;
+            }
+            else if (argv[i] == "--backend"s && hasValue){
+                std::string backend = argv[++i];
+                if (backend != "sdl" && backend != "raster"){
+                    throw std::runtime_error{ "unknown backend: " + backend };
+                }
+                options.raster = backend == "raster";
+            }
+            else if (argv[i] == "--scale"s && hasValue){
+                options.scale = std::max(std::stoi(argv[++i]), 1);
+            }
+            else if (argv[i] == "--connect"s && hasValue){
+                options.connect = argv[++i];
+            }
+            else if (argv[i] == "--no-ghost"s){
+                options.ghost = false;
+            }
+        }
+
+        if (!options.connect.empty() && (options.autoplay || !options.recordPath.empty() || !options.replayPath.empty())){
+            throw std::runtime_error{ "--connect can't be combined with --autoplay, --record or --replay" };
+        }
+
+        // a replay has its own seed and keys, the recorder would start from neither.
+        if (!options.recordPath.empty() && !options.replayPath.empty()){
+            throw std::runtime_error{ "--record can't be combined with --replay" };
+        }
+
+        auto tetris = std::make_unique<Tetris>(options);
         tetris->start();
     }
     catch(std::exception const& e){
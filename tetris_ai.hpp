@@ -0,0 +1,275 @@
+#ifndef TETRIS_AI_HPP
+#define TETRIS_AI_HPP
+
+/**
+ * a built-in player.
+ *
+ * for the current block, the bot tries every rotation and every column, drops the block
+ * with the same try_move() rules the game uses, scores the resulting board and
+ * plays the best one through TetrisGame::step(), exactly like a keyboard would.
+ *
+ * different candidates often land on the same board (every rotation of O, two of I, S
+ * and Z), so the scores are cached by the Zobrist hash of the landed board in a
+ * TranspositionTable the search threads share.
+*/
+
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "tetris_core.hpp"
+#include "tetris_thread_pool.hpp"
+#include "tetris_transposition.hpp"
+
+/**
+ * the features of a board worked out from scratch, by scanning every row. the board keeps
+ * its own up to date (BasicTetrisMap::get_features()), this is what they must agree with.
+*/
+template <int Width, int Height>
+inline BoardFeatures compute_board_features(const BasicTetrisMap<Width, Height>& tetrisMap) noexcept {
+    using Map = BasicTetrisMap<Width, Height>;
+    using Row = typename Map::Row;
+
+    BoardFeatures features;
+    int heights[Width] = {};
+    Row seen = 0;
+
+    for (int r = 0; r < Map::ALL_HEIGHT; ++r){
+        Row row = tetrisMap.get_row(r);
+        Row newColumns = row & static_cast<Row>(~seen);
+
+        for (int c = 0; newColumns != 0; ++c, newColumns >>= 1){
+            if (newColumns & 1u){
+                heights[c] = Map::ALL_HEIGHT - r;
+            }
+        }
+
+        seen |= row;
+        Row holeBits = seen & static_cast<Row>(~row);
+        for (; holeBits != 0; holeBits &= holeBits - 1){
+            ++features.holes;
+        }
+    }
+
+    for (int c = 0; c < Width; ++c){
+        features.aggregateHeight += heights[c];
+
+        if (c > 0){
+            features.bumpiness += std::abs(heights[c] - heights[c - 1]);
+        }
+
+        int left = c > 0 ? heights[c - 1] : Map::ALL_HEIGHT;
+        int right = c + 1 < Width ? heights[c + 1] : Map::ALL_HEIGHT;
+        features.wells += std::max(std::min(left, right) - heights[c], 0);
+    }
+
+    return features;
+}
+
+struct BotWeights {
+    double aggregateHeight = -0.510066;
+    double linesCleared = 0.760666;
+    double holes = -0.35663;
+    double bumpiness = -0.184483;
+    double wells = 0;              // not part of the tuned weights, there for other tunings.
+};
+
+/**
+ * one final position of the current block, and how to get there from the spawn point:
+ * rotateTimes presses of rotate, then |shift| presses of left (< 0) or right (> 0),
+ * then down until it lands.
+*/
+struct Placement {
+    int rotateTimes = 0;
+    int shift = 0;
+    double score = -std::numeric_limits<double>::infinity();
+    bool reachable = false;
+};
+
+/**
+ * 64K entries, 1 MB.
+*/
+constexpr std::size_t BOT_TABLE_ENTRIES = std::size_t{ 1 } << 16;
+
+/**
+ * the bot for a BasicTetrisGame<Width, Height>, TetrisBot plays the default board.
+*/
+template <int Width, int Height>
+class BasicTetrisBot {
+    using Game = BasicTetrisGame<Width, Height>;
+    using Map = BasicTetrisMap<Width, Height>;
+
+    BotWeights weights;
+    ThreadPool pool;
+
+    // scores of landed boards that cleared no line, by hash. null when turned off.
+    std::unique_ptr<TranspositionTable> table;
+
+    // the plan for the block the bot is currently moving.
+    std::vector<Action> plan;
+    std::size_t planStep = 0;
+    int plannedPiece = -1;
+
+    /**
+    * every column a block can be shifted to lies in [-PIECE_MASK_COL_OFFSET, Width + PIECE_MASK_COL_OFFSET).
+    */
+    static constexpr int CANDIDATE_COLS = BasicPieceMaskTable<Width>::COLS;
+    static constexpr int CANDIDATE_COUNT = 4 * CANDIDATE_COLS;
+
+    /**
+    * the score of a landed board. lost is whether anything sticks into the extra rows:
+    * the game is over then, never pick that.
+    */
+    double evaluate(const BoardFeatures& features, int linesCleared, bool lost) const noexcept {
+        if (lost){
+            return -std::numeric_limits<double>::max();
+        }
+
+        return weights.aggregateHeight * features.aggregateHeight
+            + weights.linesCleared * linesCleared
+            + weights.holes * features.holes
+            + weights.bumpiness * features.bumpiness
+            + weights.wells * features.wells;
+    }
+
+    Placement evaluate_candidate(const Map& tetrisMap, BlockInfo blockInfo, int candidate) const noexcept {
+        Placement placement;
+        placement.rotateTimes = candidate / CANDIDATE_COLS;
+
+        for (int i = 0; i < placement.rotateTimes; ++i){
+            if (!try_move(tetrisMap, blockInfo, Action::Rotate)){
+                return placement;
+            }
+        }
+
+        int targetCol = candidate % CANDIDATE_COLS - PIECE_MASK_COL_OFFSET;
+        placement.shift = targetCol - blockInfo.get_pos().col;
+        Action shiftAction = placement.shift < 0 ? Action::Left : Action::Right;
+
+        for (int i = std::abs(placement.shift); i > 0; --i){
+            if (!try_move(tetrisMap, blockInfo, shiftAction)){
+                return placement;
+            }
+        }
+
+        try_move(tetrisMap, blockInfo, Action::HardDrop);
+
+        placement.reachable = true;
+
+        // the landed board's hash, whether it completes a line and whether it reaches the
+        // extra rows, without building it yet.
+        const auto& mask = blockInfo.get_mask<Width>();
+        int topRow = blockInfo.get_pos().row + mask.top;
+        std::uint64_t landedHash = tetrisMap.get_hash();
+        bool completesLine = false;
+        bool lost = !tetrisMap.check_row_is_empty(TETRIS_EXTRA_HEIGHT);
+
+        for (int i = 0; i < 4; ++i){
+            if (mask.rows[i] != 0){
+                landedHash ^= zobrist_row_hash(topRow + i, mask.rows[i]);
+                completesLine = completesLine || (tetrisMap.get_row(topRow + i) | mask.rows[i]) == Map::FULL_ROW;
+                lost = lost || topRow + i == TETRIS_EXTRA_HEIGHT;
+            }
+        }
+
+        // with no line cleared, the score only depends on the landed board.
+        bool cacheable = table && !completesLine;
+        if (cacheable && table->probe(landedHash, placement.score)){
+            return placement;
+        }
+
+        if (completesLine){
+            // the rows move, the features have to come from the board after the clear.
+            Map landed = tetrisMap;
+            int linesCleared = landed.lock_block(blockInfo).count;
+            placement.score = evaluate(landed.get_features(), linesCleared, !landed.check_row_is_empty(TETRIS_EXTRA_HEIGHT));
+        }
+        else {
+            placement.score = evaluate(tetrisMap.get_features_with(blockInfo), 0, lost);
+        }
+
+        if (cacheable){
+            table->store(landedHash, placement.score);
+        }
+
+        return placement;
+    }
+public:
+    /**
+    * tableEntries is the size of the score cache, 0 turns it off.
+    */
+    explicit BasicTetrisBot(int threadCount = static_cast<int>(std::thread::hardware_concurrency()), BotWeights _weights = BotWeights{},
+                            std::size_t tableEntries = BOT_TABLE_ENTRIES)
+        : weights{ _weights }, pool{ std::max(threadCount, 1) }
+    {
+        if (tableEntries > 0){
+            table = std::make_unique<TranspositionTable>(tableEntries);
+        }
+    }
+
+    /**
+    * score every (rotation, column) candidate on the pool, and return the best one.
+    * ties go to the lowest candidate index, so the choice never depends on thread timing.
+    */
+    Placement find_best_placement(const Map& tetrisMap, const BlockInfo& blockInfo) {
+        Placement placements[CANDIDATE_COUNT];
+
+        pool.parallel_for(CANDIDATE_COUNT, [&](int candidate) {
+            placements[candidate] = evaluate_candidate(tetrisMap, blockInfo, candidate);
+        });
+
+        Placement best;
+        for (Placement const& placement : placements){
+            if (placement.reachable && (!best.reachable || placement.score > best.score)){
+                best = placement;
+            }
+        }
+
+        return best;
+    }
+
+    /**
+    * forget the current plan. call it before the bot starts on another game, the plan is
+    * keyed on the pieces placed and a new game counts from zero again.
+    */
+    void reset() noexcept {
+        plan.clear();
+        planStep = 0;
+        plannedPiece = -1;
+    }
+
+    /**
+    * the next key the bot would press. call it once per frame to watch the bot play,
+    * it plans again by itself whenever a new block appears.
+    */
+    Action next_action(const Game& game) {
+        if (plannedPiece != game.get_pieces_placed()){
+            plannedPiece = game.get_pieces_placed();
+            plan.clear();
+            planStep = 0;
+
+            Placement best = find_best_placement(game.get_map(), game.get_block_info());
+            plan.insert(plan.end(), best.rotateTimes, Action::Rotate);
+            plan.insert(plan.end(), std::abs(best.shift), best.shift < 0 ? Action::Left : Action::Right);
+        }
+
+        // once the block is in place, drop it.
+        return planStep < plan.size() ? plan[planStep++] : Action::HardDrop;
+    }
+
+    /**
+    * move the current block all the way to the bot's choice and land it.
+    */
+    void play_piece(Game& game) {
+        int piece = game.get_pieces_placed();
+
+        while (!game.is_game_over() && game.get_pieces_placed() == piece){
+            game.step(next_action(game));
+        }
+    }
+};
+
+using TetrisBot = BasicTetrisBot<TETRIS_WIDTH, TETRIS_HEIGHT>;
+
+#endif
@@ -0,0 +1,240 @@
+#include <iostream>
+#include <exception>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include "tetris_core.hpp"
+#include "tetris_ai.hpp"
+#include "tetris_replay.hpp"
+#include "tetris_scheduler.hpp"
+
+/**
+ * headless self-play: run many independent seeded games on every core and
+ * print one aggregated report as JSON.
+ *
+ * usage: tetris-batch [--games N] [--threads N] [--seed N] [--max-pieces N] [--random] [--record replay-file]
+ *                     [--board WxH]
+ *
+ * game i is played with seed (seed + i), so any single game of a batch can be replayed
+ * alone. by default the bot plays, --random makes every move a uniformly random key.
+ * a game ends at game over or after max-pieces blocks, whichever comes first.
+ *
+ * --record writes every game to replay-file, in game order, one record per game. there
+ * is no clock here, so the events are timed one millisecond apart.
+ *
+ * --board plays on another board than the default 16x28: 10x20, 32x28 or 64x28. replays
+ * don't store the board size, so --record only works on the default one.
+*/
+
+using namespace std::string_literals;
+
+struct BatchOptions {
+    long games = 1000;
+    // hardware_concurrency() is 0 when it can't tell.
+    int threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    std::uint32_t seed = 0;
+    int maxPieces = 1000;
+    bool randomPlayer = false;
+    std::string recordPath;
+    std::string board = "16x28";
+};
+
+struct GameStats {
+    int lines = 0;
+    int pieces = 0;
+    long steps = 0;         // how many actions the game survived.
+    bool gameOver = false;
+};
+
+/**
+ * everything one worker needs, nothing in here is ever touched by another thread.
+*/
+template <int Width, int Height>
+struct alignas(64) BatchWorker {
+    BasicTetrisBot<Width, Height> bot{ 1 };
+    std::mt19937 mt;
+};
+
+/**
+ * play one game, and record it into replay when that is not null.
+*/
+template <int Width, int Height>
+GameStats play_game(BatchWorker<Width, Height>& worker, BatchOptions const& options, std::uint32_t seed, std::vector<std::uint8_t>* replay) {
+    BasicTetrisGame<Width, Height> game{ seed };
+    GameStats stats;
+    ReplayWriter writer;
+
+    worker.mt.seed(seed);
+    worker.bot.reset();
+    writer.begin(seed);
+
+    while (!game.is_game_over() && game.get_pieces_placed() < options.maxPieces){
+        Action action = options.randomPlayer ? static_cast<Action>(1 + worker.mt() % 4) : worker.bot.next_action(game);
+
+        if (replay != nullptr){
+            writer.record(static_cast<std::uint32_t>(stats.steps), action);
+        }
+
+        game.step(action);
+        ++stats.steps;
+    }
+
+    if (replay != nullptr){
+        *replay = writer.finish(game);
+    }
+
+    stats.lines = game.get_lines_cleared();
+    stats.pieces = game.get_pieces_placed();
+    stats.gameOver = game.is_game_over();
+    return stats;
+}
+
+template <typename Field>
+void print_distribution(std::ostream& out, std::string const& name, std::vector<GameStats> const& allStats, Field field) {
+    std::vector<double> values;
+    values.reserve(allStats.size());
+    for (GameStats const& stats : allStats){
+        values.push_back(static_cast<double>(field(stats)));
+    }
+
+    std::sort(values.begin(), values.end());
+
+    double sum = 0;
+    for (double value : values){
+        sum += value;
+    }
+
+    auto percentile = [&values](double p) {
+        return values[static_cast<std::size_t>(p * (values.size() - 1))];
+    };
+
+    out << "    \"" << name << "\": { \"total\": " << sum
+        << ", \"mean\": " << sum / values.size()
+        << ", \"min\": " << values.front()
+        << ", \"p50\": " << percentile(0.5)
+        << ", \"p90\": " << percentile(0.9)
+        << ", \"max\": " << values.back() << " }";
+}
+
+BatchOptions parse_options(int argc, char* argv[]) {
+    BatchOptions options;
+
+    for (int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--games" && hasValue){
+            options.games = std::stol(argv[++i]);
+        }
+        else if (arg == "--threads" && hasValue){
+            options.threads = std::stoi(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue){
+            options.seed = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--max-pieces" && hasValue){
+            options.maxPieces = std::stoi(argv[++i]);
+        }
+        else if (arg == "--random"){
+            options.randomPlayer = true;
+        }
+        else if (arg == "--record" && hasValue){
+            options.recordPath = argv[++i];
+        }
+        else if (arg == "--board" && hasValue){
+            options.board = argv[++i];
+        }
+        else {
+            throw std::runtime_error{ "unknown option: "s + arg };
+        }
+    }
+
+    if (options.games <= 0 || options.threads <= 0 || options.maxPieces <= 0){
+        throw std::runtime_error{ "--games, --threads and --max-pieces must be positive" };
+    }
+
+    if (options.board != "16x28" && options.board != "10x20" && options.board != "32x28" && options.board != "64x28"){
+        throw std::runtime_error{ "unsupported board: " + options.board };
+    }
+
+    if (options.board != "16x28" && !options.recordPath.empty()){
+        throw std::runtime_error{ "--record only works on the default 16x28 board" };
+    }
+
+    return options;
+}
+
+template <int Width, int Height>
+void run_batch(BatchOptions const& options) {
+    WorkStealingScheduler scheduler{ options.threads };
+    std::vector<BatchWorker<Width, Height>> workers(static_cast<std::size_t>(scheduler.get_thread_count()));
+    std::vector<GameStats> allStats(static_cast<std::size_t>(options.games));
+    std::vector<std::vector<std::uint8_t>> replays(options.recordPath.empty() ? 0 : static_cast<std::size_t>(options.games));
+
+    auto start = std::chrono::steady_clock::now();
+
+    scheduler.run(options.games, [&](int worker, long index) {
+        std::vector<std::uint8_t>* replay = replays.empty() ? nullptr : &replays[index];
+        allStats[index] = play_game(workers[worker], options, options.seed + static_cast<std::uint32_t>(index), replay);
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!options.recordPath.empty()){
+        std::ofstream file{ options.recordPath, std::ios::binary | std::ios::trunc };
+
+        for (auto const& replay : replays){
+            file.write(reinterpret_cast<const char*>(replay.data()), static_cast<std::streamsize>(replay.size()));
+        }
+
+        if (!file){
+            throw std::runtime_error{ "write replay failed: " + options.recordPath };
+        }
+    }
+
+    long gameOvers = std::count_if(allStats.begin(), allStats.end(), [](GameStats const& stats) { return stats.gameOver; });
+
+    std::cout << "{\n"
+              << "  \"games\": " << options.games << ",\n"
+              << "  \"threads\": " << scheduler.get_thread_count() << ",\n"
+              << "  \"seed\": " << options.seed << ",\n"
+              << "  \"board\": \"" << Width << "x" << Height << "\",\n"
+              << "  \"player\": \"" << (options.randomPlayer ? "random" : "bot") << "\",\n"
+              << "  \"max_pieces\": " << options.maxPieces << ",\n"
+              << "  \"game_overs\": " << gameOvers << ",\n"
+              << "  \"seconds\": " << seconds << ",\n"
+              << "  \"games_per_second\": " << options.games / seconds << ",\n"
+              << "  \"stats\": {\n";
+
+    print_distribution(std::cout, "lines", allStats, [](GameStats const& stats) { return stats.lines; });
+    std::cout << ",\n";
+    print_distribution(std::cout, "pieces", allStats, [](GameStats const& stats) { return stats.pieces; });
+    std::cout << ",\n";
+    print_distribution(std::cout, "steps", allStats, [](GameStats const& stats) { return stats.steps; });
+    std::cout << "\n  }\n}\n";
+}
+
+int main(int argc, char* argv[]){
+    try {
+        BatchOptions options = parse_options(argc, argv);
+
+        if (options.board == "10x20"){
+            run_batch<10, 20>(options);
+        }
+        else if (options.board == "32x28"){
+            run_batch<32, 28>(options);
+        }
+        else if (options.board == "64x28"){
+            run_batch<64, 28>(options);
+        }
+        else {
+            run_batch<TETRIS_WIDTH, TETRIS_HEIGHT>(options);
+        }
+    }
+    catch(std::exception const& e){
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef TETRIS_CLOCK_HPP
+#define TETRIS_CLOCK_HPP
+
+/**
+ * a fixed-timestep clock for the simulation.
+ *
+ * the main loop passes the current value of a high resolution counter (such as
+ * SDL_GetPerformanceCounter()) to advance(), and gets back how many fixed steps of
+ * simulated time are due since the last call. the loop runs exactly that many steps,
+ * so gravity depends on elapsed time only, not on frame rate or a timer thread.
+ *
+ * the clock knows nothing about SDL, a headless caller can feed it any counter.
+ *
+ * simulated time runs timeScale times as fast as the counter, and an unthrottled
+ * clock ignores the counter altogether: every advance() is exactly one step.
+ *
+ * the get_millisec_until_*() functions tell an event-driven loop how long it may sleep.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+class FixedStepClock {
+    std::uint64_t frequency;      // counter ticks per second.
+    std::uint64_t stepTicks;      // counter ticks per step at 1x.
+    std::uint32_t stepMillisec;
+    double timeScale;
+    bool unthrottled;
+    std::uint64_t maxCatchUpSteps;
+
+    std::uint64_t startCount = 0;
+    std::uint64_t simulatedTicks = 0;
+    std::uint64_t skippedTicks = 0;     // simulated time given up after stalls.
+    std::uint64_t steps = 0;
+
+    /**
+    * real milliseconds from now until the simulation reaches simulatedTarget, rounded up.
+    */
+    std::uint32_t get_millisec_until_ticks(double simulatedTarget, std::uint64_t now) const noexcept {
+        if (unthrottled){
+            return 0;
+        }
+
+        double realTarget = static_cast<double>(startCount) + (simulatedTarget + static_cast<double>(skippedTicks)) / timeScale;
+        double remaining = realTarget - static_cast<double>(now);
+
+        return remaining > 0 ? static_cast<std::uint32_t>(std::ceil(remaining * 1000 / static_cast<double>(frequency))) : 0;
+    }
+public:
+    /**
+    * after a stall (a dragged window, a debugger) at most maxCatchUpSteps steps are run
+    * at once, the rest of the stall is dropped instead of fast-forwarding the game.
+    */
+    static constexpr int DEFAULT_MAX_CATCH_UP_STEPS = 8;
+
+    FixedStepClock(std::uint64_t _frequency, std::uint32_t _stepMillisec, double _timeScale = 1.0,
+                   bool _unthrottled = false, int _maxCatchUpSteps = DEFAULT_MAX_CATCH_UP_STEPS)
+        : frequency{ std::max<std::uint64_t>(_frequency, 1) },
+          stepTicks{ std::max<std::uint64_t>(frequency * _stepMillisec / 1000, 1) },
+          stepMillisec{ _stepMillisec },
+          timeScale{ _timeScale > 0 ? _timeScale : 1.0 },
+          unthrottled{ _unthrottled },
+          maxCatchUpSteps{ static_cast<std::uint64_t>(std::max(_maxCatchUpSteps, 1)) }
+    {}
+
+    void start(std::uint64_t now) noexcept {
+        startCount = now;
+        simulatedTicks = 0;
+        skippedTicks = 0;
+        steps = 0;
+    }
+
+    /**
+    * how many steps to run now, never more than the catch-up limit.
+    */
+    int advance(std::uint64_t now) noexcept {
+        if (unthrottled){
+            ++steps;
+            simulatedTicks = steps * stepTicks;
+            return 1;
+        }
+
+        // scale the whole elapsed time rather than each frame, so rounding never drifts.
+        simulatedTicks = static_cast<std::uint64_t>(static_cast<double>(now - startCount) * timeScale) - skippedTicks;
+
+        std::uint64_t due = simulatedTicks / stepTicks - steps;
+        if (due > maxCatchUpSteps){
+            skippedTicks += (due - maxCatchUpSteps) * stepTicks;
+            simulatedTicks -= (due - maxCatchUpSteps) * stepTicks;
+            due = maxCatchUpSteps;
+        }
+
+        steps += due;
+        return static_cast<int>(due);
+    }
+
+    bool is_unthrottled() const noexcept {
+        return unthrottled;
+    }
+
+    std::uint64_t get_steps() const noexcept {
+        return steps;
+    }
+
+    /**
+    * how long until advance() returns a step again, 0 for an unthrottled clock.
+    */
+    std::uint32_t get_millisec_until_next_step(std::uint64_t now) const noexcept {
+        return get_millisec_until_ticks(static_cast<double>((steps + 1) * stepTicks), now);
+    }
+
+    /**
+    * how long until simulated time reaches timeMillisec, such as the next event of a replay.
+    */
+    std::uint32_t get_millisec_until(std::uint32_t timeMillisec, std::uint64_t now) const noexcept {
+        return get_millisec_until_ticks(static_cast<double>(timeMillisec) * static_cast<double>(frequency) / 1000, now);
+    }
+
+    /**
+    * simulated time as of the last advance(), what replays are stamped with.
+    */
+    std::uint32_t get_time_millisec() const noexcept {
+        if (unthrottled){
+            return static_cast<std::uint32_t>(steps * stepMillisec);
+        }
+
+        return static_cast<std::uint32_t>(simulatedTicks * 1000 / frequency);
+    }
+};
+
+#endif
@@ -0,0 +1,1212 @@
+#ifndef TETRIS_CORE_HPP
+#define TETRIS_CORE_HPP
+
+/**
+ * headless tetris engine.
+ *
+ * everything here is pure game logic: no window, no renderer, no timer thread.
+ * a front-end (the SDL one in tetris.cpp, or a simulation driver) owns a TetrisGame,
+ * feeds it actions through step() and reads the board back for drawing.
+*/
+
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+#include <vector>
+
+/**
+ * the default board. BasicTetrisMap / BasicTetrisGame take any other size as
+ * template arguments, TetrisMap / TetrisGame are this one.
+*/
+constexpr int TETRIS_WIDTH = 16;
+constexpr int TETRIS_HEIGHT = 28;
+
+/**
+ * under normal circumstances, players want a part of the block to appear
+ * from the top of the screen and then gradually appear as a whole, that's
+ * why a extra height is used here.
+ *
+ * 4 is the longest block: I's length, so these 4 rows could contain all kinds of blocks.
+*/
+constexpr int TETRIS_EXTRA_HEIGHT = 4;
+
+constexpr int TETRIS_ALL_HEIGHT = TETRIS_HEIGHT + TETRIS_EXTRA_HEIGHT;
+
+/**
+ * the 7 blocks, then Garbage: the colour of rows an opponent sent in versus mode.
+*/
+enum Block {
+    I, O, T, S, Z, J, L, Garbage, Empty
+};
+
+struct Pos {
+    int row, col;
+};
+
+/**
+ * (row, column)
+ *
+ *      O           O           O             row axis
+ *   (0, -1)     (0, 0)      (0, 1)
+ *
+ *                  O
+ *               (1, 0)
+ *
+ *
+ *             column  axis
+*/
+constexpr Pos blockShapeMap[][4][4] = {
+    // block I.
+    {
+        { { 0, 0 }, {  0, -1 }, {  0,  1, }, {  0,  2 } },   // 0 degrees.
+        { { 0, 0 }, { -1,  0 }, {  1,  0, }, {  2,  0 } },   // 90 degrees.
+        { { 0, 0 }, {  0,  1 }, {  0, -1, }, {  0, -2 } },   // 180 degrees.
+        { { 0, 0 }, {  1,  0 }, { -1,  0, }, { -2,  0 } },   // 270 degrees.
+    },
+    // block O.
+    {
+        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
+        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
+        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
+        { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } },
+    },
+    // block T.
+    {
+        { { 0, 0 }, {  0, -1 }, {  0,  1 }, {  1,  0 } },
+        { { 0, 0 }, { -1,  0 }, {  1,  0 }, {  0, -1 } },
+        { { 0, 0 }, {  0,  1 }, {  0, -1 }, { -1,  0 } },
+        { { 0, 0 }, {  1,  0 }, { -1,  0 }, {  0,  1 } },
+    },
+    // block S.
+    {
+        { { -1, -1 }, {  0, -1 }, { 0, 0 }, {  1,  0 } },
+        { { -1,  1 }, { -1,  0 }, { 0, 0 }, {  0, -1 } },
+        { {  1,  1 }, {  0,  1 }, { 0, 0 }, { -1,  0 } },
+        { {  1, -1 }, {  1,  0 }, { 0, 0 }, {  0,  1 } },
+    },
+    // block Z.
+    {
+        { { -1,  0 }, { 0, 0 }, {  0, -1 }, {  1, -1 } },
+        { {  0,  1 }, { 0, 0 }, { -1,  0 }, { -1, -1 } },
+        { {  1,  0 }, { 0, 0 }, {  0,  1 }, { -1,  1 } },
+        { {  0, -1 }, { 0, 0 }, {  1,  0 }, {  1,  1 } },
+    },
+    // block J.
+    {
+        { { 0, 0 }, { -1,  0 }, { -2,  0 }, {  0, -1 } },
+        { { 0, 0 }, {  0,  1 }, {  0,  2 }, { -1,  0 } },
+        { { 0, 0 }, {  1,  0 }, {  2,  0 }, {  0,  1 } },
+        { { 0, 0 }, {  0, -1 }, {  0, -2 }, {  1,  0 } }
+    },
+    // block L.
+    {
+        { { 0, 0 }, { -1,  0 }, { -2,  0 }, {  0,  1 } },
+        { { 0, 0 }, {  0,  1 }, {  0,  2 }, {  1,  0 } },
+        { { 0, 0 }, {  1,  0 }, {  2,  0 }, {  0, -1 } },
+        { { 0, 0 }, {  0, -1 }, {  0, -2 }, { -1,  0 } },
+    }
+};
+
+/**
+ * one bit per cell, bit c of a row word is column c.
+ * a board row is held in the narrowest word that fits Width cells.
+*/
+template <int Width>
+using RowBitsFor = std::conditional_t<Width <= 16, std::uint16_t,
+                   std::conditional_t<Width <= 32, std::uint32_t, std::uint64_t>>;
+
+/**
+ * the Width lowest bits set.
+*/
+template <int Width>
+constexpr RowBitsFor<Width> full_row() noexcept {
+    using Row = RowBitsFor<Width>;
+    return Width == 8 * sizeof(Row) ? static_cast<Row>(~Row{ 0 }) : static_cast<Row>((Row{ 1 } << Width) - 1);
+}
+
+/**
+ * rows below the floor are stored as full rows, so a block that goes through
+ * the bottom collides with them like with any other block, without a bounds check.
+ * 4 rows are enough for the tallest block (I) to sink completely.
+*/
+constexpr int TETRIS_FLOOR_ROWS = 4;
+
+/**
+ * a block at one rotation and one column, already shifted into row words.
+ *
+ * rows[i] is what the block occupies in board row (pos.row + top + i), unused rows are 0.
+ * if any cell of the block falls outside the left / right border at this column,
+ * inBounds is false and the position always collides.
+*/
+template <typename Row>
+struct BasicPieceMask {
+    Row rows[4];
+    int top;
+    bool inBounds;
+};
+
+/**
+ * column offsets in blockShapeMap lie in [-2, 2], and a block is never more than one
+ * column past its last legal position, so pos.col always lies in [-2, Width + 1].
+*/
+constexpr int PIECE_MASK_COL_OFFSET = 2;
+
+template <int Width>
+struct BasicPieceMaskTable {
+    static constexpr int COLS = Width + 2 * PIECE_MASK_COL_OFFSET;
+
+    BasicPieceMask<RowBitsFor<Width>> masks[7][4][COLS];
+};
+
+template <int Width>
+constexpr BasicPieceMaskTable<Width> make_piece_mask_table() {
+    using Row = RowBitsFor<Width>;
+    BasicPieceMaskTable<Width> table{};
+
+    for (int b = 0; b < 7; ++b){
+        for (int rot = 0; rot < 4; ++rot){
+            const Pos* shape = blockShapeMap[b][rot];
+
+            int top = shape[0].row;
+            for (int i = 1; i < 4; ++i){
+                top = std::min(top, shape[i].row);
+            }
+
+            for (int c = 0; c < BasicPieceMaskTable<Width>::COLS; ++c){
+                BasicPieceMask<Row>& mask = table.masks[b][rot][c];
+                int col = c - PIECE_MASK_COL_OFFSET;
+
+                mask.top = top;
+                mask.inBounds = true;
+
+                for (int i = 0; i < 4; ++i){
+                    int cellCol = col + shape[i].col;
+
+                    if (cellCol < 0 || cellCol >= Width){
+                        mask.inBounds = false;
+                    }
+                    else {
+                        mask.rows[shape[i].row - top] |= static_cast<Row>(Row{ 1 } << cellCol);
+                    }
+                }
+            }
+        }
+    }
+
+    return table;
+}
+
+template <int Width>
+inline constexpr BasicPieceMaskTable<Width> pieceMaskTableFor = make_piece_mask_table<Width>();
+
+/**
+ * the names for the default board, which is what the front-ends draw.
+*/
+using RowBits = RowBitsFor<TETRIS_WIDTH>;
+using PieceMask = BasicPieceMask<RowBits>;
+using PieceMaskTable = BasicPieceMaskTable<TETRIS_WIDTH>;
+
+constexpr RowBits TETRIS_FULL_ROW = full_row<TETRIS_WIDTH>();
+constexpr int PIECE_MASK_COLS = PieceMaskTable::COLS;
+inline constexpr const PieceMaskTable& pieceMaskTable = pieceMaskTableFor<TETRIS_WIDTH>;
+
+class BlockInfo {
+    Block block;
+    Pos pos;
+    int rotateTimes;
+public:
+    BlockInfo()
+        : block{ Block::Empty }, pos{ 0, 0 }, rotateTimes{ 0 }
+    {}
+
+    BlockInfo(Block _block, int row, int col, int _rotateTimes)
+        : block{ _block }, pos{ row, col }, rotateTimes{ _rotateTimes }
+    {}
+
+    Block get_block() const noexcept {
+        return block;
+    }
+
+    Pos get_pos() const noexcept {
+        return pos;
+    }
+
+    int get_rotate_times() const noexcept {
+        return rotateTimes;
+    }
+
+    const Pos* get_shape() const noexcept {
+        return blockShapeMap[static_cast<int>(block)][rotateTimes];
+    }
+
+    /**
+    * the mask of the block where it is, on a board Width columns wide.
+    */
+    template <int Width = TETRIS_WIDTH>
+    const BasicPieceMask<RowBitsFor<Width>>& get_mask() const noexcept {
+        return pieceMaskTableFor<Width>.masks[static_cast<int>(block)][rotateTimes][pos.col + PIECE_MASK_COL_OFFSET];
+    }
+
+    /**
+    * visitors are taken as template parameters rather than std::function,
+    * so the lambda is inlined and the 4 iterations unroll into straight-line code.
+    */
+    template <typename BlockInfoAction>
+    void for_each_shape_point(BlockInfoAction&& action) const {
+        const Pos* shape = get_shape();
+
+        for (int i = 0; i < 4; ++i) {
+            int row = pos.row + shape[i].row;
+            int col = pos.col + shape[i].col;
+
+            action(row, col);
+        }
+    }
+
+    template <typename BlockInfoCond>
+    bool for_each_shape_point_if(BlockInfoCond&& cond) const {
+        const Pos* shape = get_shape();
+
+        for (int i = 0; i < 4; ++i) {
+            int row = pos.row + shape[i].row;
+            int col = pos.col + shape[i].col;
+
+            if (cond(row, col)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void rotate() noexcept {
+        rotateTimes = (rotateTimes + 1) % 4;
+    }
+
+    void un_rotate() noexcept {
+        rotateTimes = (rotateTimes + 3) % 4;
+    }
+
+    void go_left() noexcept {
+        pos.col -= 1;
+    }
+
+    void go_right() noexcept {
+        pos.col += 1;
+    }
+
+    void go_down() noexcept {
+        pos.row += 1;
+    }
+
+    void go_top() noexcept {
+        pos.row -= 1;
+    }
+};
+
+/**
+ * is b exactly where a was? (same block, position and rotation)
+*/
+inline bool same_place(const BlockInfo& a, const BlockInfo& b) noexcept {
+    return a.get_block() == b.get_block()
+        && a.get_pos().row == b.get_pos().row
+        && a.get_pos().col == b.get_pos().col
+        && a.get_rotate_times() == b.get_rotate_times();
+}
+
+/**
+ * rows removed by one eliminate_lines() call, from the bottom up, as they were
+ * numbered before the board was compacted. a block spans at most 4 rows,
+ * so at most 4 lines go at once.
+*/
+struct ClearedLines {
+    int count = 0;
+    int rows[4];
+};
+
+/**
+ * one bit per board row, bit r is row r, so a board has at most 64 rows in all.
+*/
+using DirtyRows = std::uint64_t;
+
+/**
+ * the rows in [topRow, bottomRow].
+*/
+constexpr DirtyRows dirty_row_range(int topRow, int bottomRow) noexcept {
+    return topRow > bottomRow ? 0 : (~DirtyRows{ 0 } >> (63 - bottomRow + topRow)) << topRow;
+}
+
+constexpr DirtyRows ALL_ROWS_DIRTY = dirty_row_range(0, TETRIS_ALL_HEIGHT - 1);
+
+/**
+ * a Zobrist key for every cell a board of up to 64 x 64 can have, drawn with splitmix64
+ * at compile time. a board's hash is the XOR of the keys of its occupied cells, so it
+ * follows every change to a cell with one XOR.
+*/
+struct ZobristKeys {
+    std::uint64_t cells[64][64];
+};
+
+constexpr std::uint64_t splitmix64(std::uint64_t& state) noexcept {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys make_zobrist_keys() noexcept {
+    ZobristKeys keys{};
+    std::uint64_t state = 0x5EED7E7215ull;
+
+    for (auto& row : keys.cells){
+        for (std::uint64_t& key : row){
+            key = splitmix64(state);
+        }
+    }
+
+    return keys;
+}
+
+inline constexpr ZobristKeys zobristKeys = make_zobrist_keys();
+
+inline int lowest_bit(std::uint64_t value) noexcept {
+#if defined(__GNUC__)
+    return __builtin_ctzll(value);
+#else
+    int bit = 0;
+    while ((value & 1u) == 0){
+        value >>= 1;
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+inline int bit_count(std::uint64_t value) noexcept {
+#if defined(__GNUC__)
+    return __builtin_popcountll(value);
+#else
+    int count = 0;
+    for (; value != 0; value &= value - 1){
+        ++count;
+    }
+    return count;
+#endif
+}
+
+/**
+ * the XOR of the keys of the cells set in row bits of board row r.
+*/
+template <typename Row>
+inline std::uint64_t zobrist_row_hash(int r, Row bits) noexcept {
+    std::uint64_t hash = 0;
+
+    for (std::uint64_t cells = bits; cells != 0; cells &= cells - 1){
+        hash ^= zobristKeys.cells[r][lowest_bit(cells)];
+    }
+
+    return hash;
+}
+
+/**
+ * the shape of a board as a bot sees it. a column's height counts from the bottom row up
+ * to its topmost occupied cell, the extra rows included.
+*/
+struct BoardFeatures {
+    int aggregateHeight = 0;   // sum of the column heights.
+    int holes = 0;             // empty cells with a filled cell somewhere above them.
+    int bumpiness = 0;         // sum of height differences between neighbour columns.
+    int wells = 0;             // sum over columns of how far both neighbours rise above it, the sides count as walls.
+};
+
+/**
+ * a board Width columns wide with Height visible rows, TETRIS_EXTRA_HEIGHT more above them.
+ *
+ * the dimensions are template parameters so the row word, the arrays and every loop are
+ * sized at compile time: a 10 column board works on 16-bit rows, a 64 column one on
+ * 64-bit rows, and loops over the columns or rows have constant trip counts.
+*/
+template <int Width, int Height>
+class BasicTetrisMap {
+public:
+    static constexpr int WIDTH = Width;
+    static constexpr int HEIGHT = Height;
+    static constexpr int ALL_HEIGHT = Height + TETRIS_EXTRA_HEIGHT;
+
+    using Row = RowBitsFor<Width>;
+    using Mask = BasicPieceMask<Row>;
+
+    static constexpr Row FULL_ROW = full_row<Width>();
+    static constexpr DirtyRows ALL_ROWS_DIRTY = dirty_row_range(0, ALL_HEIGHT - 1);
+
+    // a horizontal I spawned at column Width / 2 reaches one column further right than it
+    // does left, it only fits from 5 columns up.
+    static_assert(Width >= 5 && Width <= 64, "a row is at most one 64-bit word, and must fit every block where it spawns");
+    static_assert(Height >= 4 && ALL_HEIGHT <= 64, "DirtyRows needs a bit per row");
+private:
+    /**
+    * the board is kept in two planes: occupancy bits, which is all the game logic
+    * ever looks at (collision, full / empty rows), and the colour of every cell,
+    * which is only needed for drawing. a colour is meaningless where its bit is 0.
+    */
+    Row rows[ALL_HEIGHT + TETRIS_FLOOR_ROWS];
+    std::uint8_t colors[ALL_HEIGHT][Width];
+
+    // rows changed since the last clear_dirty_rows(), so a renderer can redraw just those.
+    DirtyRows dirtyRows;
+
+    // the Zobrist hash of the occupied cells, see get_hash().
+    std::uint64_t hash;
+
+    // the topmost occupied row of every column, ALL_HEIGHT where a column is empty.
+    std::uint8_t columnTops[Width];
+
+    // kept up to date with columnTops and cellCount, see get_features().
+    BoardFeatures features;
+    int cellCount;
+
+    /**
+    * the height of column col, the sides of the board are walls as high as the board.
+    */
+    static int column_height(const std::uint8_t (&tops)[Width], int col) noexcept {
+        return col < 0 || col >= Width ? ALL_HEIGHT : ALL_HEIGHT - tops[col];
+    }
+
+    static int well_depth(const std::uint8_t (&tops)[Width], int col) noexcept {
+        int sides = std::min(column_height(tops, col - 1), column_height(tops, col + 1));
+        return std::max(sides - column_height(tops, col), 0);
+    }
+
+    /**
+    * move the top of column col and bring boardFeatures along: only the terms of col and
+    * its two neighbours change. holes are left to the caller, they also need the cell count.
+    */
+    static void move_column_top(BoardFeatures& boardFeatures, std::uint8_t (&tops)[Width], int col, int top) noexcept {
+        int first = std::max(col - 1, 0);
+        int last = std::min(col + 1, Width - 1);
+
+        for (int c = first; c <= last; ++c){
+            boardFeatures.wells -= well_depth(tops, c);
+        }
+        for (int c = first; c < last; ++c){
+            boardFeatures.bumpiness -= std::abs(column_height(tops, c) - column_height(tops, c + 1));
+        }
+        boardFeatures.aggregateHeight -= column_height(tops, col);
+
+        tops[col] = static_cast<std::uint8_t>(top);
+
+        for (int c = first; c <= last; ++c){
+            boardFeatures.wells += well_depth(tops, c);
+        }
+        for (int c = first; c < last; ++c){
+            boardFeatures.bumpiness += std::abs(column_height(tops, c) - column_height(tops, c + 1));
+        }
+        boardFeatures.aggregateHeight += column_height(tops, col);
+    }
+
+    void update_holes() noexcept {
+        // every cell under a column's top is either filled or a hole.
+        features.holes = features.aggregateHeight - cellCount;
+    }
+
+    /**
+    * every write to a whole row goes through here, to keep the hash. only the cells that
+    * change flip their keys, so moving a row onto a similar one is cheap. the cell count
+    * is left to the caller: moving rows around doesn't change it.
+    */
+    void set_row(int row, Row bits) noexcept {
+        hash ^= zobrist_row_hash(row, static_cast<Row>(rows[row] ^ bits));
+        rows[row] = bits;
+    }
+
+    void copy_row_to_row(int fromRow, int toRow) noexcept {
+        set_row(toRow, rows[fromRow]);
+        std::copy(std::cbegin(colors[fromRow]), std::cend(colors[fromRow]), std::begin(colors[toRow]));
+    }
+
+    /**
+    * find every column top again from the rows, and the features from them. one pass
+    * from the top, each row only settles the columns no row above it has.
+    */
+    void update_column_tops() noexcept {
+        std::fill(std::begin(columnTops), std::end(columnTops), static_cast<std::uint8_t>(ALL_HEIGHT));
+        Row open = FULL_ROW;
+
+        for (int r = 0; r < ALL_HEIGHT && open != 0; ++r){
+            Row tops = rows[r] & open;
+            open &= static_cast<Row>(~tops);
+
+            for (std::uint64_t cells = tops; cells != 0; cells &= cells - 1){
+                columnTops[lowest_bit(cells)] = static_cast<std::uint8_t>(r);
+            }
+        }
+
+        update_features();
+    }
+
+    /**
+    * work the features out again from the column tops, without reading the rows.
+    */
+    void update_features() noexcept {
+        features = BoardFeatures{};
+        for (int c = 0; c < Width; ++c){
+            features.aggregateHeight += column_height(columnTops, c);
+            features.wells += well_depth(columnTops, c);
+
+            if (c > 0){
+                features.bumpiness += std::abs(column_height(columnTops, c) - column_height(columnTops, c - 1));
+            }
+        }
+
+        update_holes();
+    }
+
+    /**
+    * move every column top down by count rows, up when count is negative. all the heights
+    * change by the same amount, so of the features only the aggregate height does, as
+    * long as no column rises past the walls. the caller puts right the tops that moved
+    * differently, a top may be off the board until then.
+    */
+    void shift_column_tops(int count) noexcept {
+        for (std::uint8_t& top : columnTops){
+            top = static_cast<std::uint8_t>(top + count);
+        }
+        features.aggregateHeight -= count * Width;
+    }
+
+public:
+    BasicTetrisMap() {
+        clear();
+    }
+
+    void clear() noexcept {
+        std::fill(rows, rows + ALL_HEIGHT, Row{ 0 });
+        std::fill(rows + ALL_HEIGHT, std::end(rows), FULL_ROW);
+        dirtyRows = ALL_ROWS_DIRTY;
+        hash = 0;
+        cellCount = 0;
+        update_column_tops();
+    }
+
+    DirtyRows get_dirty_rows() const noexcept {
+        return dirtyRows;
+    }
+
+    void clear_dirty_rows() noexcept {
+        dirtyRows = 0;
+    }
+
+    void mark_all_rows_dirty() noexcept {
+        dirtyRows = ALL_ROWS_DIRTY;
+    }
+
+    Row get_row(int row) const noexcept {
+        return rows[row];
+    }
+
+    /**
+    * the Zobrist hash of which cells are occupied (colours don't count), kept up to date
+    * by every change to the board: two boards with the same cells filled have the same
+    * hash, whatever order the blocks came in. the floor rows are not part of it.
+    */
+    std::uint64_t get_hash() const noexcept {
+        return hash;
+    }
+
+    /**
+    * the topmost occupied row of column col, ALL_HEIGHT if it is empty.
+    */
+    int get_column_top(int col) const noexcept {
+        return columnTops[col];
+    }
+
+    /**
+    * heights, holes, bumpiness and wells of the board, kept up to date by every change:
+    * a cell only moves its own column's top, which only touches the terms of that column
+    * and its neighbours. line clears and garbage rows shift every top by the same amount,
+    * which only changes the aggregate height, then move the few tops that differ.
+    */
+    const BoardFeatures& get_features() const noexcept {
+        return features;
+    }
+
+    /**
+    * the features the board would have with blockInfo locked where it is, without
+    * building that board, for a block that completes no line (the rows would move).
+    * the cost is in the columns the block covers, not in the size of the board.
+    */
+    BoardFeatures get_features_with(const BlockInfo& blockInfo) const noexcept {
+        BoardFeatures withBlock = features;
+        std::uint8_t tops[Width];
+        std::copy(std::begin(columnTops), std::end(columnTops), tops);
+
+        blockInfo.for_each_shape_point([&withBlock, &tops](int row, int col) {
+            if (row < tops[col]){
+                move_column_top(withBlock, tops, col, row);
+            }
+        });
+
+        withBlock.holes = withBlock.aggregateHeight - (cellCount + 4);
+        return withBlock;
+    }
+
+    bool is_occupied(int row, int col) const noexcept {
+        return (rows[row] >> col) & 1u;
+    }
+
+    Block get(int row, int col) const noexcept {
+        return is_occupied(row, col) ? static_cast<Block>(colors[row][col]) : Block::Empty;
+    }
+
+    void set(int row, int col, Block block) noexcept {
+        Row bit = static_cast<Row>(Row{ 1 } << col);
+        dirtyRows |= DirtyRows{ 1 } << row;
+
+        if ((block == Block::Empty) == ((rows[row] & bit) != 0)){
+            hash ^= zobristKeys.cells[row][col];
+            cellCount += block == Block::Empty ? -1 : 1;
+        }
+
+        if (block == Block::Empty){
+            rows[row] &= static_cast<Row>(~bit);
+
+            // only emptying the top cell moves the top, down to the next occupied one.
+            if (row == columnTops[col]){
+                int top = row + 1;
+                while (top < ALL_HEIGHT && !is_occupied(top, col)){
+                    ++top;
+                }
+                move_column_top(features, columnTops, col, top);
+            }
+        }
+        else {
+            rows[row] |= bit;
+            colors[row][col] = static_cast<std::uint8_t>(block);
+
+            if (row < columnTops[col]){
+                move_column_top(features, columnTops, col, row);
+            }
+        }
+
+        update_holes();
+    }
+
+    /**
+    * does the block described by mask, with its center at row, hit anything?
+    * 4 ANDs, no per-cell loop: borders are encoded in the mask, the floor in the sentinel rows.
+    */
+    bool collides(const Mask& mask, int row) const noexcept {
+        const Row* r = rows + row + mask.top;
+
+        return !mask.inBounds
+            || ((r[0] & mask.rows[0]) | (r[1] & mask.rows[1]) | (r[2] & mask.rows[2]) | (r[3] & mask.rows[3])) != 0;
+    }
+
+    bool collides(const BlockInfo& blockInfo) const noexcept {
+        return collides(blockInfo.get_mask<Width>(), blockInfo.get_pos().row);
+    }
+
+    /**
+    * how many rows blockInfo (where it doesn't collide) can fall before it lands.
+    *
+    * when every cell of the block is above the top of its column, nothing lies between a
+    * cell and that top, so the distance is the smallest gap, read from the column tops
+    * without touching the rows. a block tucked under an overhang has a cell below its
+    * column's top, that one falls back to stepping down the rows.
+    */
+    int drop_distance(const BlockInfo& blockInfo) const noexcept {
+        int distance = ALL_HEIGHT;
+
+        bool underOverhang = blockInfo.for_each_shape_point_if([this, &distance](int row, int col) {
+            int top = columnTops[col];
+            distance = std::min(distance, top - row - 1);
+            return top <= row;
+        });
+
+        if (underOverhang){
+            const Mask& mask = blockInfo.get_mask<Width>();
+            int row = blockInfo.get_pos().row;
+
+            distance = 0;
+            while (!collides(mask, row + distance + 1)){
+                ++distance;
+            }
+        }
+
+        return distance;
+    }
+
+    bool check_row_is_full(int rowIndex) const noexcept {
+        return rows[rowIndex] == FULL_ROW;
+    }
+
+    bool check_row_is_empty(int rowIndex) const noexcept {
+        return rows[rowIndex] == 0;
+    }
+
+    /**
+    * remove the full rows among [topRow, bottomRow], the rows of the block that just landed,
+    * no other row can have become full.
+    *
+    * the board is compacted in a single pass from the lowest full row upwards: every
+    * surviving row is copied at most once, straight to its final place. the pass stops at
+    * the first empty row, since nothing can float above an empty row.
+    */
+    ClearedLines eliminate_lines(int topRow, int bottomRow) noexcept {
+        ClearedLines cleared;
+
+        for (int r = std::min(bottomRow, ALL_HEIGHT - 1); r >= topRow; --r){
+            if (check_row_is_full(r)){
+                cleared.rows[cleared.count++] = r;
+            }
+        }
+
+        if (cleared.count == 0){
+            return cleared;
+        }
+
+        int toRow = cleared.rows[0];
+        int nextCleared = 1;
+        int fromRow = toRow - 1;
+
+        for (; fromRow >= 0 && !check_row_is_empty(fromRow); --fromRow){
+            if (nextCleared < cleared.count && fromRow == cleared.rows[nextCleared]){
+                ++nextCleared;
+            }
+            else {
+                copy_row_to_row(fromRow, toRow--);
+            }
+        }
+
+        // every row from the lowest cleared one up to the first empty one has changed.
+        dirtyRows |= dirty_row_range(fromRow + 1, cleared.rows[0]);
+
+        // rows above fromRow are already empty, the ones left between are stale copies.
+        for (; toRow > fromRow; --toRow){
+            set_row(toRow, 0);
+        }
+
+        // a full row is under every column's top, so a top that survived is above all the
+        // cleared rows and comes down by all of them. a column whose top was the highest
+        // cleared row lost it, the new one is the next cell down from where it came to.
+        int highestCleared = cleared.rows[cleared.count - 1];
+        shift_column_tops(cleared.count);
+
+        for (int c = 0; c < Width; ++c){
+            if (columnTops[c] == highestCleared + cleared.count){
+                int top = columnTops[c];
+                while (top < ALL_HEIGHT && !is_occupied(top, c)){
+                    ++top;
+                }
+                move_column_top(features, columnTops, c, top);
+            }
+        }
+
+        cellCount -= cleared.count * Width;
+        update_holes();
+        return cleared;
+    }
+
+    /**
+    * push the board up by count rows and fill the bottom ones with garbage: full rows
+    * but for a hole in holeCol. whatever is pushed past the top row is lost.
+    */
+    void add_garbage_rows(int count, int holeCol) noexcept {
+        count = std::min(count, ALL_HEIGHT);
+        if (count <= 0){
+            return;
+        }
+
+        // rows above the first non-empty one are empty, and stay so.
+        int topRow = 0;
+        while (topRow < ALL_HEIGHT && check_row_is_empty(topRow)){
+            ++topRow;
+        }
+
+        // the rows pushed past the top take their cells with them.
+        for (int r = topRow; r < count; ++r){
+            cellCount -= bit_count(rows[r]);
+        }
+        cellCount += count * (Width - 1);
+
+        for (int r = std::max(topRow - count, 0); r + count < ALL_HEIGHT; ++r){
+            copy_row_to_row(r + count, r);
+        }
+
+        Row garbage = static_cast<Row>(FULL_ROW & ~(Row{ 1 } << holeCol));
+        for (int r = ALL_HEIGHT - count; r < ALL_HEIGHT; ++r){
+            set_row(r, garbage);
+            std::fill(std::begin(colors[r]), std::end(colors[r]), static_cast<std::uint8_t>(Block::Garbage));
+        }
+
+        dirtyRows |= dirty_row_range(std::max(topRow - count, 0), ALL_HEIGHT - 1);
+
+        if (topRow < count){
+            // cells were pushed off the board, the tops of their columns are lost.
+            update_column_tops();
+            return;
+        }
+
+        // every top rises by count, an empty column's meets the garbage at the same row,
+        // but for the hole column, which stays empty.
+        bool holeColumnEmpty = columnTops[holeCol] == ALL_HEIGHT;
+        shift_column_tops(-count);
+        if (holeColumnEmpty){
+            move_column_top(features, columnTops, holeCol, ALL_HEIGHT);
+        }
+
+        update_holes();
+    }
+
+    /**
+    * write a landed block into the board and remove the lines it completed.
+    */
+    ClearedLines lock_block(const BlockInfo& blockInfo) noexcept {
+        blockInfo.for_each_shape_point([this, &blockInfo](int row, int col) {
+            set(row, col, blockInfo.get_block());
+        });
+
+        int topRow = blockInfo.get_pos().row + blockInfo.get_mask<Width>().top;
+        return eliminate_lines(topRow, topRow + 3);
+    }
+};
+
+/**
+ * the default board, the one the front-ends draw.
+*/
+using TetrisMap = BasicTetrisMap<TETRIS_WIDTH, TETRIS_HEIGHT>;
+
+/**
+ * everything a player (keyboard, timer, bot or replay) can ask the game to do.
+ * None is a no-op step, handy for drivers that only want to advance bookkeeping.
+ * Gravity does what Down does, it only tells a timer tick apart from a key press.
+ * HardDrop drops the block as far as it goes and locks it, in one step.
+*/
+enum class Action : std::uint8_t {
+    None, Left, Right, Rotate, Down, Gravity, HardDrop
+};
+
+/**
+ * the movement rules: try one move of blockInfo on tetrisMap (any BasicTetrisMap), undo it if it collides.
+ * returns whether the block actually moved. Down never locks anything here,
+ * a blocked Down is what tells the caller the block has landed. HardDrop moves it
+ * to where it would land (BasicTetrisMap::drop_distance()), and doesn't lock it either.
+ *
+ * TetrisGame plays through this, and so does anything that searches ahead
+ * on a copy of the board, so both always agree on what is reachable.
+*/
+template <typename Map>
+inline bool try_move(const Map& tetrisMap, BlockInfo& blockInfo, Action action) noexcept {
+    switch (action) {
+        case Action::Left:
+            blockInfo.go_left();
+            if (tetrisMap.collides(blockInfo)){
+                blockInfo.go_right();
+                return false;
+            }
+            return true;
+        case Action::Right:
+            blockInfo.go_right();
+            if (tetrisMap.collides(blockInfo)){
+                blockInfo.go_left();
+                return false;
+            }
+            return true;
+        case Action::Rotate:
+            blockInfo.rotate();
+            if (tetrisMap.collides(blockInfo)){
+                blockInfo.un_rotate();
+                return false;
+            }
+            return true;
+        case Action::Down:
+            blockInfo.go_down();
+            if (tetrisMap.collides(blockInfo)){
+                blockInfo.go_top();
+                return false;
+            }
+            return true;
+        case Action::HardDrop: {
+            int distance = tetrisMap.drop_distance(blockInfo);
+            for (int i = 0; i < distance; ++i){
+                blockInfo.go_down();
+            }
+            return distance > 0;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * blockInfo where it would land on tetrisMap, for a ghost piece. a block that already
+ * collides (the game is over) stays where it is.
+*/
+template <typename Map>
+inline BlockInfo ghost_block_info(const Map& tetrisMap, BlockInfo blockInfo) noexcept {
+    if (!tetrisMap.collides(blockInfo)){
+        try_move(tetrisMap, blockInfo, Action::HardDrop);
+    }
+    return blockInfo;
+}
+
+/**
+ * the game itself: board + current block + random source.
+ *
+ * the random generator is seeded explicitly, so the same seed and the same
+ * sequence of step() calls always produce the same game, on a board of any size.
+*/
+template <int Width, int Height>
+class BasicTetrisGame {
+public:
+    using Map = BasicTetrisMap<Width, Height>;
+
+    /**
+    * everything that changes as the game is played, but the random generator: a
+    * snapshot for rollback or undo is a copy of this, one memcpy of 696 bytes on the
+    * default board, as bench's rollback/snapshot reports (std::mt19937 alone is 5000
+    * bytes with 64-bit libstdc++).
+    */
+    struct State {
+        Map tetrisMap;
+        BlockInfo blockInfo;
+        ClearedLines lastClearedLines;
+        int linesCleared = 0;
+        int piecesPlaced = 0;
+        bool gameOver = false;
+
+        // how many blocks have been dealt, an index into dealtBlocks.
+        std::uint32_t dealtCount = 0;
+    };
+
+    static_assert(std::is_trivially_copyable_v<State>, "a snapshot must be a plain copy");
+private:
+    State state;
+
+    // random generator.
+    std::mt19937 mt;
+    std::uniform_int_distribution<unsigned int> randomBlock{ 0, 6 };
+    std::uniform_int_distribution<unsigned int> randomRotation{ 0, 3 };
+
+    // every block dealt since reset(), as block << 2 | rotation. the generator only
+    // ever moves forward: a game restored to an earlier state is dealt these again.
+    std::vector<std::uint8_t> dealtBlocks;
+
+public:
+    explicit BasicTetrisGame(std::uint32_t seed = 0) {
+        reset(seed);
+    }
+
+    /**
+    * start a brand new game, the whole block sequence is decided by seed.
+    */
+    void reset(std::uint32_t seed) {
+        state.tetrisMap.clear();
+        state.lastClearedLines = ClearedLines{};
+        state.linesCleared = 0;
+        state.piecesPlaced = 0;
+        state.gameOver = false;
+        state.dealtCount = 0;
+        mt.seed(seed);
+        randomBlock.reset();
+        randomRotation.reset();
+        dealtBlocks.clear();
+        random_gen_current_block();
+    }
+
+    /**
+    * replace the current block with a new random one at the spawn point.
+    * move_down() calls it when a block lands, drivers may call it directly.
+    */
+    void random_gen_current_block() {
+        if (state.dealtCount == dealtBlocks.size()){
+            // 7 kind of blocks: I, O, T, S, Z, J, L.
+            unsigned int block = randomBlock(mt);
+
+            // 4 rotations: 0, 1, 2, 3, present 0, 90, 180, 270 degrees.
+            unsigned int rotateTimes = randomRotation(mt);
+
+            dealtBlocks.push_back(static_cast<std::uint8_t>(block << 2 | rotateTimes));
+        }
+
+        std::uint8_t dealt = dealtBlocks[state.dealtCount++];
+        Block block = static_cast<Block>(dealt >> 2);
+        int rotateTimes = dealt & 3;
+
+        // new block should be centered.
+        int col = Width / 2;
+
+        /**
+        * Default row can't be 0. because the blockShapeMap we defined above,
+        * are based on the center point. Assuming we get a block I, and it is vertical,
+        * then on the top of the center point, there should be at least 2 blocks space.
+        * that's why the default row should be 2 here.
+        */
+        int row = 2;
+
+        state.blockInfo = BlockInfo{ block, row, col, rotateTimes };
+    }
+
+    /**
+    * a snapshot of the game, to go back to with restore_state().
+    */
+    const State& get_state() const noexcept {
+        return state;
+    }
+
+    /**
+    * go back to a snapshot taken from this game since its last reset(). the whole board
+    * is reported dirty, as a renderer can't know what differs from the frame it drew.
+    */
+    void restore_state(const State& snapshot) noexcept {
+        state = snapshot;
+        state.tetrisMap.mark_all_rows_dirty();
+    }
+
+    const Map& get_map() const noexcept {
+        return state.tetrisMap;
+    }
+
+    const BlockInfo& get_block_info() const noexcept {
+        return state.blockInfo;
+    }
+
+    /**
+    * the current block where it would land, for a ghost piece.
+    */
+    BlockInfo get_ghost_block_info() const noexcept {
+        return ghost_block_info(state.tetrisMap, state.blockInfo);
+    }
+
+    bool is_game_over() const noexcept {
+        return state.gameOver;
+    }
+
+    /**
+    * lines removed when the last block landed, for scoring and animation.
+    */
+    const ClearedLines& get_last_cleared_lines() const noexcept {
+        return state.lastClearedLines;
+    }
+
+    int get_lines_cleared() const noexcept {
+        return state.linesCleared;
+    }
+
+    /**
+    * how many blocks have landed so far, it also tells drivers when a new block appeared.
+    */
+    int get_pieces_placed() const noexcept {
+        return state.piecesPlaced;
+    }
+
+    /**
+    * the board rows changed since the last call, for a renderer that only redraws those.
+    * the current block isn't part of the board, its moves are never reported here.
+    */
+    DirtyRows take_dirty_rows() noexcept {
+        DirtyRows dirtyRows = state.tetrisMap.get_dirty_rows();
+        state.tetrisMap.clear_dirty_rows();
+        return dirtyRows;
+    }
+
+    void move_left() noexcept {
+        try_move(state.tetrisMap, state.blockInfo, Action::Left);
+    }
+
+    void move_right() noexcept {
+        try_move(state.tetrisMap, state.blockInfo, Action::Right);
+    }
+
+    void move_down() {
+        if (!try_move(state.tetrisMap, state.blockInfo, Action::Down)){
+            state.lastClearedLines = state.tetrisMap.lock_block(state.blockInfo);
+            state.linesCleared += state.lastClearedLines.count;
+            ++state.piecesPlaced;
+
+            // if TETRIS_EXTRA_HEIGHT row has any blocks, then game over.
+            if (!state.tetrisMap.check_row_is_empty(TETRIS_EXTRA_HEIGHT)){
+                state.gameOver = true;
+            }
+
+            random_gen_current_block();
+        }
+    }
+
+    void rotate() noexcept {
+        try_move(state.tetrisMap, state.blockInfo, Action::Rotate);
+    }
+
+    /**
+    * drop the current block to where it lands and lock it there.
+    */
+    void hard_drop() {
+        try_move(state.tetrisMap, state.blockInfo, Action::HardDrop);
+        move_down();
+    }
+
+    /**
+    * receive count garbage rows from an opponent (see BasicTetrisMap::add_garbage_rows()).
+    * the current block is lifted out of the way if the rows reach it. the game is lost
+    * once the board reaches the extra rows, as it would be at the next landing.
+    */
+    void add_garbage(int count, int holeCol) noexcept {
+        if (state.gameOver || count <= 0){
+            return;
+        }
+
+        state.tetrisMap.add_garbage_rows(count, holeCol);
+
+        // collides() reads the rows under the block's top cell, so the block is only tested
+        // where that cell is on the board. one that can't go higher has no room left.
+        auto top_row = [this] {
+            return state.blockInfo.get_pos().row + state.blockInfo.template get_mask<Width>().top;
+        };
+
+        bool blocked = state.tetrisMap.collides(state.blockInfo);
+        while (blocked && top_row() > 0){
+            state.blockInfo.go_top();
+            blocked = state.tetrisMap.collides(state.blockInfo);
+        }
+
+        if (blocked || !state.tetrisMap.check_row_is_empty(TETRIS_EXTRA_HEIGHT)){
+            state.gameOver = true;
+        }
+    }
+
+    /**
+    * advance the game by one action. once the game is over, further steps are ignored.
+    */
+    void step(Action action) {
+        if (state.gameOver){
+            return;
+        }
+
+        switch (action) {
+            case Action::Left:
+                move_left();
+                break;
+            case Action::Right:
+                move_right();
+                break;
+            case Action::Rotate:
+                rotate();
+                break;
+            case Action::Down:
+            case Action::Gravity:
+                move_down();
+                break;
+            case Action::HardDrop:
+                hard_drop();
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+using TetrisGame = BasicTetrisGame<TETRIS_WIDTH, TETRIS_HEIGHT>;
+
+#endif
@@ -0,0 +1,162 @@
+#include <cstring>
+#include <vector>
+#include "tetris_env.h"
+#include "tetris_core.hpp"
+#include "tetris_pool.hpp"
+
+/**
+ * the C interface of tetris_env.h over a SessionPool.
+ *
+ * a board only changes when a block lands, and tick() knows which sessions that was, so
+ * a step rewrites the board plane, reward and done of those only (about one environment
+ * in twenty) and the few bytes of the pieces for everyone.
+*/
+
+constexpr int ENV_BOARD_CELLS = TETRIS_ALL_HEIGHT * TETRIS_WIDTH;
+
+struct TetrisEnv {
+    SessionPool pool;
+    TetrisEnvBuffers buffers;
+    std::uint32_t seed;
+    std::vector<std::uint32_t> episodes;    // how many episodes each environment has started.
+    std::vector<int> lines;                 // lines of each episode so far, to turn totals into rewards.
+    std::vector<Action> actions;
+    std::vector<int> rewarded;              // environments whose reward or done must go back to 0 next step.
+
+    TetrisEnv(int count, std::uint32_t _seed, TetrisEnvBuffers const& _buffers)
+        : pool{ count }, buffers(_buffers), seed{ _seed }, episodes(count), lines(count), actions(count)
+    {
+        rewarded.reserve(count);
+    }
+
+    int get_count() const noexcept {
+        return pool.get_capacity();
+    }
+
+    void start_episode(int env) {
+        std::uint32_t episodeSeed = seed + static_cast<std::uint32_t>(env) + episodes[env]++ * static_cast<std::uint32_t>(get_count());
+
+        if (env < pool.get_session_count()){
+            pool.reset_session(env, episodeSeed);
+        }
+        else {
+            pool.add_session(episodeSeed);
+        }
+
+        lines[env] = 0;
+    }
+
+    void write_board(int env) noexcept {
+        std::uint8_t* cells = buffers.boards + static_cast<std::size_t>(env) * ENV_BOARD_CELLS;
+
+        for (int r = 0; r < TETRIS_ALL_HEIGHT; ++r){
+            RowBits row = pool.get_row(env, r);
+
+            for (int c = 0; c < TETRIS_WIDTH; ++c){
+                cells[r * TETRIS_WIDTH + c] = static_cast<std::uint8_t>((row >> c) & 1u);
+            }
+        }
+    }
+
+    void write_piece(int env) noexcept {
+        std::int8_t* piece = buffers.pieces + static_cast<std::size_t>(env) * TETRIS_ENV_PIECE_FIELDS;
+        BlockInfo blockInfo = pool.get_block_info(env);
+
+        piece[TETRIS_ENV_PIECE_KIND] = static_cast<std::int8_t>(blockInfo.get_block());
+        piece[TETRIS_ENV_PIECE_ROTATION] = static_cast<std::int8_t>(blockInfo.get_rotate_times());
+        piece[TETRIS_ENV_PIECE_ROW] = static_cast<std::int8_t>(blockInfo.get_pos().row);
+        piece[TETRIS_ENV_PIECE_COL] = static_cast<std::int8_t>(blockInfo.get_pos().col);
+        piece[TETRIS_ENV_PIECE_NEXT_KIND] = static_cast<std::int8_t>(pool.get_next_block(env));
+    }
+
+    void reset() {
+        for (int env = 0; env < get_count(); ++env){
+            start_episode(env);
+            write_board(env);
+            write_piece(env);
+            buffers.rewards[env] = 0;
+            buffers.dones[env] = 0;
+        }
+
+        rewarded.clear();
+    }
+
+    int step(const std::uint8_t* stepActions) {
+        for (int env : rewarded){
+            buffers.rewards[env] = 0;
+            buffers.dones[env] = 0;
+        }
+        rewarded.clear();
+
+        // Action is a byte, but reading the caller's bytes as Actions would break aliasing rules.
+        std::memcpy(actions.data(), stepActions, actions.size());
+        pool.tick(actions.data());
+
+        int done = 0;
+        for (int env : pool.get_landed()){
+            int total = pool.get_lines_cleared(env);
+            buffers.rewards[env] = static_cast<float>(total - lines[env]);
+            lines[env] = total;
+            rewarded.push_back(env);
+
+            if (pool.is_game_over(env)){
+                start_episode(env);
+                buffers.dones[env] = 1;
+                ++done;
+            }
+
+            write_board(env);
+        }
+
+        for (int env = 0; env < get_count(); ++env){
+            write_piece(env);
+        }
+
+        return done;
+    }
+};
+
+extern "C" {
+
+int tetris_env_rows(void) {
+    return TETRIS_ALL_HEIGHT;
+}
+
+int tetris_env_cols(void) {
+    return TETRIS_WIDTH;
+}
+
+TetrisEnv* tetris_env_create(int count, uint32_t seed, const TetrisEnvBuffers* buffers) {
+    if (count <= 0 || buffers == nullptr || buffers->boards == nullptr || buffers->pieces == nullptr
+        || buffers->rewards == nullptr || buffers->dones == nullptr){
+        return nullptr;
+    }
+
+    // no exception may cross the C boundary.
+    try {
+        TetrisEnv* env = new TetrisEnv{ count, seed, *buffers };
+        env->reset();
+        return env;
+    }
+    catch (...){
+        return nullptr;
+    }
+}
+
+void tetris_env_destroy(TetrisEnv* env) {
+    delete env;
+}
+
+int tetris_env_count(const TetrisEnv* env) {
+    return env->get_count();
+}
+
+void tetris_env_reset(TetrisEnv* env) {
+    env->reset();
+}
+
+int tetris_env_step(TetrisEnv* env, const uint8_t* actions) {
+    return env->step(actions);
+}
+
+}
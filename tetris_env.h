@@ -0,0 +1,91 @@
+#ifndef TETRIS_ENV_H
+#define TETRIS_ENV_H
+
+/**
+ * a C interface to many games at once, for reinforcement learning: one call steps every
+ * environment with an array of actions, and the observations, rewards and episode ends
+ * are written straight into arrays the caller handed over when creating it (numpy arrays,
+ * tensors in pinned memory...). nothing is copied out, and nothing is allocated per step.
+ *
+ * the games run in a SessionPool (tetris_pool.hpp) on the default 16 x 28 board. an
+ * environment whose game is over starts a new one right away, within the same step.
+ *
+ * build the library with `make tetris-env`.
+*/
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define TETRIS_ENV_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define TETRIS_ENV_API __attribute__((visibility("default")))
+#else
+#define TETRIS_ENV_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the actions, as in tetris_core.hpp: none, left, right, rotate, down (gravity is 5, same as down), hard drop. */
+enum {
+    TETRIS_ENV_NONE = 0,
+    TETRIS_ENV_LEFT = 1,
+    TETRIS_ENV_RIGHT = 2,
+    TETRIS_ENV_ROTATE = 3,
+    TETRIS_ENV_DOWN = 4,
+    TETRIS_ENV_HARD_DROP = 6
+};
+
+/* what pieces holds for every environment, in this order. kinds are 0 to 6: I, O, T, S, Z, J, L. */
+enum {
+    TETRIS_ENV_PIECE_KIND = 0,
+    TETRIS_ENV_PIECE_ROTATION = 1,
+    TETRIS_ENV_PIECE_ROW = 2,       /* of the block's center, in board rows. */
+    TETRIS_ENV_PIECE_COL = 3,
+    TETRIS_ENV_PIECE_NEXT_KIND = 4,
+    TETRIS_ENV_PIECE_FIELDS = 5
+};
+
+/**
+ * the arrays the environments write to, each with one entry per environment, back to back.
+ * all of them must stay valid, and at the same address, as long as the environments live.
+*/
+typedef struct TetrisEnvBuffers {
+    uint8_t* boards;    /* [count][rows][cols]: 1 where a cell is occupied, rows from the top, extra rows included. */
+    int8_t* pieces;     /* [count][TETRIS_ENV_PIECE_FIELDS]: the falling block and the one after it. */
+    float* rewards;     /* [count]: lines cleared by the last step. */
+    uint8_t* dones;     /* [count]: 1 if the last step ended the episode, the board is then already the next one's. */
+} TetrisEnvBuffers;
+
+typedef struct TetrisEnv TetrisEnv;
+
+/* board size of the observations. */
+TETRIS_ENV_API int tetris_env_rows(void);
+TETRIS_ENV_API int tetris_env_cols(void);
+
+/**
+ * count environments, episode i of environment e starts from seed + e + i * count.
+ * the buffers are filled with the first observation. returns NULL if count isn't
+ * positive, a buffer is missing or memory runs out.
+*/
+TETRIS_ENV_API TetrisEnv* tetris_env_create(int count, uint32_t seed, const TetrisEnvBuffers* buffers);
+
+TETRIS_ENV_API void tetris_env_destroy(TetrisEnv* env);
+
+TETRIS_ENV_API int tetris_env_count(const TetrisEnv* env);
+
+/* start a new episode in every environment. */
+TETRIS_ENV_API void tetris_env_reset(TetrisEnv* env);
+
+/**
+ * advance environment e by actions[e] (one of TETRIS_ENV_*, others do nothing), then write
+ * the observations, rewards and dones. returns the number of episodes that ended.
+*/
+TETRIS_ENV_API int tetris_env_step(TetrisEnv* env, const uint8_t* actions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
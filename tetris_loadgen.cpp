@@ -0,0 +1,262 @@
+#include <iostream>
+#include <exception>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "tetris_net.hpp"
+#include "tetris_core.hpp"
+#include "tetris_metrics.hpp"
+#include "tetris_versus.hpp"
+
+/**
+ * load generator for tetris-server: many simulated players on one thread, pressing random
+ * keys at random times, then one JSON report of the traffic and of the key latency.
+ *
+ * usage: tetris-loadgen [--connect host:port] [--clients N] [--seconds N] [--keys-per-second N] [--seed N]
+ *
+ * every client decodes its States like the game would (RemoteGame), so a broken delta shows
+ * up as a decode error. a key's latency is the time from sending it to receiving the first
+ * State that acknowledges it, a full round trip through the server. keys pressed while
+ * waiting for a match aren't sent, nor are keys pressed while LOADGEN_KEYS_IN_FLIGHT
+ * earlier ones are still waiting for their acknowledgement (keys_held_back).
+*/
+
+using namespace std::string_literals;
+
+struct LoadOptions {
+    std::string host = "127.0.0.1";
+    std::string port = "7777";
+    int clients = 100;
+    double seconds = 10;
+    double keysPerSecond = 5;
+    std::uint32_t seed = 0;
+};
+
+// keys a client can have waiting for their acknowledgement, the size of its ring of send times.
+constexpr int LOADGEN_KEYS_IN_FLIGHT = 256;
+
+struct LoadClient {
+    NetConnection connection;
+    RemoteGame remoteGame;
+    bool inMatch = false;
+    std::uint16_t sequence = 0;
+    std::uint16_t acked = 0;
+    std::uint64_t sentAt[LOADGEN_KEYS_IN_FLIGHT];   // by sequence number, when it was sent, in microseconds.
+    std::uint64_t nextKeyAt = 0;
+
+    explicit LoadClient(NetSocket socket)
+        : connection{ std::move(socket) }
+    {}
+};
+
+struct LoadReport {
+    LatencyHistogram latency;
+    std::uint64_t keysSent = 0;
+    std::uint64_t keysHeldBack = 0;
+    std::uint64_t states = 0;
+    std::uint64_t decodeErrors = 0;
+    std::uint64_t disconnects = 0;
+};
+
+std::uint64_t now_microsec() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void receive(LoadClient& client, LoadReport& report, std::uint64_t now) {
+    client.connection.fill();
+
+    client.connection.for_each_frame([&](std::uint8_t type, const std::uint8_t* payload, std::size_t size) {
+        if (type == MessageWelcome){
+            // a new match: keys sent before it will never be acknowledged.
+            client.inMatch = true;
+            client.acked = client.sequence;
+            return;
+        }
+
+        if (type != MessageState){
+            return;
+        }
+
+        ++report.states;
+        if (!client.remoteGame.apply_state(payload, size)){
+            ++report.decodeErrors;
+            return;
+        }
+
+        std::uint16_t ack = client.remoteGame.get_last_input();
+        while (client.acked != ack && static_cast<std::uint16_t>(client.sequence - client.acked) >= static_cast<std::uint16_t>(ack - client.acked)){
+            ++client.acked;
+            report.latency.record(now - client.sentAt[client.acked % LOADGEN_KEYS_IN_FLIGHT]);
+        }
+    });
+
+    if (client.connection.is_closed()){
+        ++report.disconnects;
+    }
+}
+
+void press_key(LoadClient& client, LoadReport& report, std::mt19937& mt) {
+    // Left, Right, Rotate or Down.
+    Action action = static_cast<Action>(1 + mt() % 4);
+
+    // a full ring would lose the send time of a key still waiting: skip this one.
+    if (static_cast<std::uint16_t>(client.sequence - client.acked) >= LOADGEN_KEYS_IN_FLIGHT){
+        ++report.keysHeldBack;
+        return;
+    }
+
+    ++client.sequence;
+    client.sentAt[client.sequence % LOADGEN_KEYS_IN_FLIGHT] = now_microsec();
+
+    std::vector<std::uint8_t>& out = client.connection.begin_frame(MessageInput);
+    out.push_back(static_cast<std::uint8_t>(action));
+    out.push_back(static_cast<std::uint8_t>(client.sequence));
+    out.push_back(static_cast<std::uint8_t>(client.sequence >> 8));
+    client.connection.end_frame();
+
+    ++report.keysSent;
+}
+
+LoadOptions parse_options(int argc, char* argv[]) {
+    LoadOptions options;
+
+    for (int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--connect" && hasValue){
+            std::string address = argv[++i];
+            std::size_t colon = address.rfind(':');
+            if (colon == std::string::npos){
+                throw std::runtime_error{ "--connect wants host:port" };
+            }
+
+            options.host = address.substr(0, colon);
+            options.port = address.substr(colon + 1);
+        }
+        else if (arg == "--clients" && hasValue){
+            options.clients = std::stoi(argv[++i]);
+        }
+        else if (arg == "--seconds" && hasValue){
+            options.seconds = std::stod(argv[++i]);
+        }
+        else if (arg == "--keys-per-second" && hasValue){
+            options.keysPerSecond = std::stod(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue){
+            options.seed = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        }
+        else {
+            throw std::runtime_error{ "unknown option: "s + arg };
+        }
+    }
+
+    if (options.clients <= 0 || options.seconds <= 0 || options.keysPerSecond <= 0){
+        throw std::runtime_error{ "--clients, --seconds and --keys-per-second must be positive" };
+    }
+
+    return options;
+}
+
+void run_load(LoadOptions const& options) {
+    std::mt19937 mt{ options.seed };
+    std::vector<std::unique_ptr<LoadClient>> clients;
+    LoadReport report;
+
+    // keys come at random intervals, 0.5 to 1.5 times the mean one.
+    std::uint64_t meanInterval = static_cast<std::uint64_t>(1000000 / options.keysPerSecond);
+    auto next_interval = [&mt, meanInterval]() {
+        return meanInterval / 2 + mt() % (meanInterval + 1);
+    };
+
+    for (int i = 0; i < options.clients; ++i){
+        clients.push_back(std::make_unique<LoadClient>(NetSocket::connect_to(options.host, options.port)));
+        clients.back()->nextKeyAt = now_microsec() + next_interval();
+    }
+
+    std::uint64_t start = now_microsec();
+    std::uint64_t end = start + static_cast<std::uint64_t>(options.seconds * 1000000);
+    std::vector<PollFd> pollFds;
+
+    for (std::uint64_t now = start; now < end; now = now_microsec()){
+        std::uint64_t nextKeyAt = end;
+        pollFds.clear();
+
+        for (auto const& client : clients){
+            if (client->inMatch && !client->connection.is_closed()){
+                nextKeyAt = std::min(nextKeyAt, client->nextKeyAt);
+            }
+
+            short events = POLLIN | (client->connection.has_outgoing() ? POLLOUT : 0);
+            pollFds.push_back(PollFd{ client->connection.get_socket().get_handle(), events, 0 });
+        }
+
+        int timeout = static_cast<int>((std::max(nextKeyAt, now) - now + 999) / 1000);
+        net_poll(pollFds.data(), pollFds.size(), timeout);
+
+        now = now_microsec();
+        for (std::size_t i = 0; i < clients.size(); ++i){
+            LoadClient& client = *clients[i];
+
+            if (client.connection.is_closed()){
+                continue;
+            }
+
+            if (pollFds[i].revents != 0){
+                receive(client, report, now);
+            }
+
+            if (client.inMatch && client.nextKeyAt <= now){
+                press_key(client, report, mt);
+                client.nextKeyAt = std::max(client.nextKeyAt + next_interval(), now);
+            }
+
+            client.connection.flush();
+        }
+    }
+
+    double seconds = static_cast<double>(now_microsec() - start) / 1000000;
+    std::uint64_t bytesSent = 0;
+    std::uint64_t bytesReceived = 0;
+    int matched = 0;
+
+    for (auto const& client : clients){
+        bytesSent += client->connection.get_bytes_sent();
+        bytesReceived += client->connection.get_bytes_received();
+        matched += client->inMatch ? 1 : 0;
+    }
+
+    double perClient = static_cast<double>(options.clients) * seconds;
+
+    std::cout << "{\n"
+              << "  \"clients\": " << options.clients << ",\n"
+              << "  \"clients_in_match\": " << matched << ",\n"
+              << "  \"seconds\": " << seconds << ",\n"
+              << "  \"keys_sent\": " << report.keysSent << ",\n"
+              << "  \"keys_held_back\": " << report.keysHeldBack << ",\n"
+              << "  \"keys_acknowledged\": " << report.latency.get_count() << ",\n"
+              << "  \"states\": " << report.states << ",\n"
+              << "  \"decode_errors\": " << report.decodeErrors << ",\n"
+              << "  \"disconnects\": " << report.disconnects << ",\n"
+              << "  \"bytes_per_second_per_client\": { \"in\": " << static_cast<double>(bytesReceived) / perClient
+              << ", \"out\": " << static_cast<double>(bytesSent) / perClient << " },\n"
+              << "  \"latency_us\": { \"mean\": " << report.latency.get_mean()
+              << ", \"p50\": " << report.latency.get_percentile(0.5)
+              << ", \"p99\": " << report.latency.get_percentile(0.99)
+              << ", \"max\": " << report.latency.get_max() << " }\n"
+              << "}\n";
+}
+
+int main(int argc, char* argv[]){
+    try {
+        run_load(parse_options(argc, argv));
+    }
+    catch(std::exception const& e){
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,218 @@
+#ifndef TETRIS_METRICS_HPP
+#define TETRIS_METRICS_HPP
+
+/**
+ * frame timing: where the time of each main loop iteration goes, and how long a key
+ * press takes to reach the screen.
+ *
+ * every duration goes into a histogram with log-linear buckets (8 per power of two,
+ * so any value is known within 12.5%), recording is a few shifts and an increment,
+ * and nothing is allocated after construction. durations are in microseconds.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+
+class LatencyHistogram {
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_MAGNITUDE = 40;    // 2^40 us, about 12 days, anything longer is clamped.
+    static constexpr int BUCKET_COUNT = SUB_BUCKETS + (MAX_MAGNITUDE - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    std::array<std::uint32_t, BUCKET_COUNT> buckets{};
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t min = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t max = 0;
+
+    static int highest_bit(std::uint64_t value) noexcept {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1){
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+
+    /**
+    * values below SUB_BUCKETS get a bucket each, above that every power of two is
+    * split into SUB_BUCKETS equal buckets.
+    */
+    static int bucket_of(std::uint64_t value) noexcept {
+        if (value < SUB_BUCKETS){
+            return static_cast<int>(value);
+        }
+
+        value = std::min(value, (std::uint64_t{ 2 } << MAX_MAGNITUDE) - 1);
+        int magnitude = highest_bit(value);
+        int shift = magnitude - SUB_BUCKET_BITS;
+        int subBucket = static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+
+        return SUB_BUCKETS + shift * SUB_BUCKETS + subBucket;
+    }
+
+    static std::uint64_t bucket_lower_bound(int bucket) noexcept {
+        if (bucket < SUB_BUCKETS){
+            return static_cast<std::uint64_t>(bucket);
+        }
+
+        int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+        int subBucket = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+        return static_cast<std::uint64_t>(SUB_BUCKETS + subBucket) << shift;
+    }
+public:
+    void record(std::uint64_t micros) noexcept {
+        ++buckets[bucket_of(micros)];
+        ++count;
+        sum += micros;
+        min = std::min(min, micros);
+        max = std::max(max, micros);
+    }
+
+    std::uint64_t get_count() const noexcept {
+        return count;
+    }
+
+    std::uint64_t get_min() const noexcept {
+        return count == 0 ? 0 : min;
+    }
+
+    std::uint64_t get_max() const noexcept {
+        return max;
+    }
+
+    double get_mean() const noexcept {
+        return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+    }
+
+    /**
+    * the value below which a fraction p of the recordings fall, as the lower bound
+    * of its bucket, but never outside [min, max].
+    */
+    std::uint64_t get_percentile(double p) const noexcept {
+        if (count == 0){
+            return 0;
+        }
+
+        std::uint64_t rank = static_cast<std::uint64_t>(p * static_cast<double>(count - 1)) + 1;
+        std::uint64_t seen = 0;
+
+        for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket){
+            seen += buckets[bucket];
+            if (seen >= rank){
+                return std::clamp(bucket_lower_bound(bucket), get_min(), max);
+            }
+        }
+
+        return max;
+    }
+
+    /**
+    * calls visit(lowerBoundMicros, count) for every bucket that has something in it.
+    */
+    template <typename Visit>
+    void for_each_bucket(Visit&& visit) const {
+        for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket){
+            if (buckets[bucket] != 0){
+                visit(bucket_lower_bound(bucket), buckets[bucket]);
+            }
+        }
+    }
+};
+
+/**
+ * the histograms of the main loop, fed with raw counter values
+ * (SDL_GetPerformanceCounter() in the game).
+*/
+class FrameMetrics {
+public:
+    enum Stage {
+        Events,         // handling input and window events, without the game logic they trigger.
+        Logic,          // every TetrisGame::step() of the iteration: moves, locks, line clears.
+        Render,         // drawing the frame.
+        Present,        // SDL_RenderPresent().
+        InputLatency,   // from a key press entering SDL to the first present after it.
+        STAGE_COUNT
+    };
+
+    static constexpr const char* STAGE_NAMES[STAGE_COUNT] = { "events", "logic", "render", "present", "input_to_present" };
+
+    explicit FrameMetrics(std::uint64_t _frequency)
+        : frequency{ std::max<std::uint64_t>(_frequency, 1) }
+    {}
+
+    std::uint64_t to_micros(std::uint64_t ticks) const noexcept {
+        return ticks * 1000000 / frequency;
+    }
+
+    void record(Stage stage, std::uint64_t ticks) noexcept {
+        histograms[stage].record(to_micros(ticks));
+    }
+
+    void record_micros(Stage stage, std::uint64_t micros) noexcept {
+        histograms[stage].record(micros);
+    }
+
+    LatencyHistogram const& get(Stage stage) const noexcept {
+        return histograms[stage];
+    }
+
+    void write_json(std::ostream& out) const {
+        out << "{\n  \"unit\": \"us\",\n  \"histograms\": [\n";
+
+        for (int stage = 0; stage < STAGE_COUNT; ++stage){
+            LatencyHistogram const& histogram = histograms[stage];
+
+            out << "    { \"name\": \"" << STAGE_NAMES[stage] << "\"";
+            write_summary(histogram, [&out](char const* key, double value) {
+                out << ", \"" << key << "\": " << value;
+            });
+
+            out << ", \"buckets\": [";
+            bool first = true;
+            histogram.for_each_bucket([&](std::uint64_t lowerBound, std::uint32_t bucketCount) {
+                out << (first ? "" : ", ") << "[" << lowerBound << ", " << bucketCount << "]";
+                first = false;
+            });
+            out << "] }" << (stage + 1 < STAGE_COUNT ? ",\n" : "\n");
+        }
+
+        out << "  ]\n}\n";
+    }
+
+    void write_csv(std::ostream& out) const {
+        out << "stage,count,min_us,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n";
+
+        for (int stage = 0; stage < STAGE_COUNT; ++stage){
+            out << STAGE_NAMES[stage];
+            write_summary(histograms[stage], [&out](char const*, double value) {
+                out << "," << value;
+            });
+            out << "\n";
+        }
+    }
+private:
+    std::uint64_t frequency;
+    std::array<LatencyHistogram, STAGE_COUNT> histograms;
+
+    template <typename Field>
+    static void write_summary(LatencyHistogram const& histogram, Field field) {
+        field("count", static_cast<double>(histogram.get_count()));
+        field("min", static_cast<double>(histogram.get_min()));
+        field("mean", histogram.get_mean());
+        field("p50", static_cast<double>(histogram.get_percentile(0.5)));
+        field("p90", static_cast<double>(histogram.get_percentile(0.9)));
+        field("p99", static_cast<double>(histogram.get_percentile(0.99)));
+        field("p999", static_cast<double>(histogram.get_percentile(0.999)));
+        field("max", static_cast<double>(histogram.get_max()));
+    }
+};
+
+#endif
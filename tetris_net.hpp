@@ -0,0 +1,430 @@
+#ifndef TETRIS_NET_HPP
+#define TETRIS_NET_HPP
+
+/**
+ * just enough TCP for versus mode: a socket that owns its handle, a connection that
+ * buffers both ways and cuts the incoming bytes into frames, and poll().
+ *
+ * a frame is a little-endian u16 length, then that many bytes: a u8 message type and
+ * its payload. what the messages mean is up to tetris_versus.hpp.
+ *
+ * sockets are non-blocking once connected, and Nagle's algorithm is off: a key press is
+ * a few bytes that must leave now, not when more of them have piled up.
+ *
+ * on windows this must be included before anything that includes <windows.h>.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "tetris_varint.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using PollFd = WSAPOLLFD;
+constexpr SocketHandle INVALID_SOCKET_HANDLE = INVALID_SOCKET;
+#else
+using SocketHandle = int;
+using PollFd = pollfd;
+constexpr SocketHandle INVALID_SOCKET_HANDLE = -1;
+#endif
+
+inline int net_poll(PollFd* fds, std::size_t count, int timeoutMillisec) noexcept {
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeoutMillisec);
+#else
+    return poll(fds, static_cast<nfds_t>(count), timeoutMillisec);
+#endif
+}
+
+class NetSocket {
+    SocketHandle handle = INVALID_SOCKET_HANDLE;
+
+    static void startup() {
+#ifdef _WIN32
+        static bool started = [] {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+
+        if (!started){
+            throw std::runtime_error{ "WSAStartup() failed" };
+        }
+#endif
+    }
+
+    static bool would_block() noexcept {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+    }
+
+    void set_options() noexcept {
+        int one = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+    }
+public:
+    NetSocket() = default;
+
+    explicit NetSocket(SocketHandle _handle)
+        : handle{ _handle }
+    {}
+
+    NetSocket(NetSocket&& other) noexcept
+        : handle{ std::exchange(other.handle, INVALID_SOCKET_HANDLE) }
+    {}
+
+    NetSocket& operator=(NetSocket&& other) noexcept {
+        if (this != &other){
+            close();
+            handle = std::exchange(other.handle, INVALID_SOCKET_HANDLE);
+        }
+        return *this;
+    }
+
+    NetSocket(NetSocket const&) = delete;
+    NetSocket& operator=(NetSocket const&) = delete;
+
+    ~NetSocket() noexcept {
+        close();
+    }
+
+    /**
+    * a blocking connect, the socket is non-blocking afterwards.
+    */
+    static NetSocket connect_to(std::string const& host, std::string const& port) {
+        startup();
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0){
+            throw std::runtime_error{ "unknown host: " + host };
+        }
+
+        NetSocket socket;
+        for (addrinfo* address = addresses; address != nullptr; address = address->ai_next){
+            NetSocket candidate{ ::socket(address->ai_family, address->ai_socktype, address->ai_protocol) };
+
+            if (candidate.is_open() && ::connect(candidate.handle, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0){
+                socket = std::move(candidate);
+                break;
+            }
+        }
+
+        freeaddrinfo(addresses);
+
+        if (!socket.is_open()){
+            throw std::runtime_error{ "connect failed: " + host + ":" + port };
+        }
+
+        socket.set_options();
+        socket.set_nonblocking();
+        return socket;
+    }
+
+    /**
+    * a non-blocking listening socket on every IPv4 interface.
+    */
+    static NetSocket listen_on(int port) {
+        startup();
+
+        NetSocket socket{ ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) };
+        if (!socket.is_open()){
+            throw std::runtime_error{ "create socket failed" };
+        }
+
+        int one = 1;
+        setsockopt(socket.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<std::uint16_t>(port));
+
+        if (bind(socket.handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(socket.handle, SOMAXCONN) != 0){
+            throw std::runtime_error{ "listen failed on port " + std::to_string(port) };
+        }
+
+        socket.set_nonblocking();
+        return socket;
+    }
+
+    /**
+    * the next pending connection, or a closed socket when there is none.
+    */
+    NetSocket accept_one() noexcept {
+        NetSocket client{ ::accept(handle, nullptr, nullptr) };
+
+        if (client.is_open()){
+            client.set_options();
+            client.set_nonblocking();
+        }
+
+        return client;
+    }
+
+    void set_nonblocking() noexcept {
+#ifdef _WIN32
+        u_long one = 1;
+        ioctlsocket(handle, FIONBIO, &one);
+#else
+        fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    }
+
+    void set_blocking() noexcept {
+#ifdef _WIN32
+        u_long zero = 0;
+        ioctlsocket(handle, FIONBIO, &zero);
+#else
+        fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) & ~O_NONBLOCK);
+#endif
+    }
+
+    bool is_open() const noexcept {
+        return handle != INVALID_SOCKET_HANDLE;
+    }
+
+    SocketHandle get_handle() const noexcept {
+        return handle;
+    }
+
+    /**
+    * bytes sent, 0 if the socket can't take any right now, -1 if the connection is gone.
+    */
+    long send_some(const std::uint8_t* data, std::size_t size) noexcept {
+#ifdef _WIN32
+        int sent = ::send(handle, reinterpret_cast<const char*>(data), static_cast<int>(size), 0);
+#elif defined(MSG_NOSIGNAL)
+        long sent = ::send(handle, data, size, MSG_NOSIGNAL);
+#else
+        long sent = ::send(handle, data, size, 0);
+#endif
+        if (sent < 0){
+            return would_block() ? 0 : -1;
+        }
+
+        return static_cast<long>(sent);
+    }
+
+    /**
+    * bytes read, 0 if there is nothing to read right now, -1 if the connection is closed or gone.
+    */
+    long receive_some(std::uint8_t* data, std::size_t size) noexcept {
+#ifdef _WIN32
+        int received = ::recv(handle, reinterpret_cast<char*>(data), static_cast<int>(size), 0);
+#else
+        long received = ::recv(handle, data, size, 0);
+#endif
+        if (received == 0){
+            return -1;
+        }
+
+        if (received < 0){
+            return would_block() ? 0 : -1;
+        }
+
+        return static_cast<long>(received);
+    }
+
+    /**
+    * wake up a thread blocked in receive_some() on this socket, without closing the handle under it.
+    */
+    void shutdown_both() noexcept {
+        if (is_open()){
+#ifdef _WIN32
+            ::shutdown(handle, SD_BOTH);
+#else
+            ::shutdown(handle, SHUT_RDWR);
+#endif
+        }
+    }
+
+    void close() noexcept {
+        if (is_open()){
+#ifdef _WIN32
+            closesocket(handle);
+#else
+            ::close(handle);
+#endif
+            handle = INVALID_SOCKET_HANDLE;
+        }
+    }
+};
+
+/**
+ * a socket plus its unsent and unparsed bytes.
+*/
+class NetConnection {
+    NetSocket socket;
+    std::vector<std::uint8_t> incoming;
+    std::vector<std::uint8_t> outgoing;
+    std::size_t frameStart = 0;     // in outgoing, where the frame being built begins.
+    bool closed = false;
+    std::uint64_t bytesSent = 0;
+    std::uint64_t bytesReceived = 0;
+public:
+    static constexpr std::size_t MAX_FRAME_SIZE = 0xFFFF;
+
+    explicit NetConnection(NetSocket _socket)
+        : socket{ std::move(_socket) }
+    {}
+
+    NetSocket& get_socket() noexcept {
+        return socket;
+    }
+
+    bool is_closed() const noexcept {
+        return closed;
+    }
+
+    bool has_outgoing() const noexcept {
+        return !outgoing.empty();
+    }
+
+    /**
+    * bytes queued that the socket hasn't taken yet.
+    */
+    std::size_t get_outgoing_size() const noexcept {
+        return outgoing.size();
+    }
+
+    std::uint64_t get_bytes_sent() const noexcept {
+        return bytesSent;
+    }
+
+    std::uint64_t get_bytes_received() const noexcept {
+        return bytesReceived;
+    }
+
+    /**
+    * start a frame of the given type, the payload is appended to the returned buffer,
+    * then end_frame() fills in the length.
+    */
+    std::vector<std::uint8_t>& begin_frame(std::uint8_t type) {
+        frameStart = outgoing.size();
+        outgoing.insert(outgoing.end(), { 0, 0, type });
+        return outgoing;
+    }
+
+    void end_frame() {
+        std::size_t size = outgoing.size() - frameStart - 2;
+        if (size > MAX_FRAME_SIZE){
+            throw std::length_error{ "frame too large" };
+        }
+
+        outgoing[frameStart] = static_cast<std::uint8_t>(size);
+        outgoing[frameStart + 1] = static_cast<std::uint8_t>(size >> 8);
+    }
+
+    /**
+    * send what the socket takes now, false once the connection is gone.
+    */
+    bool flush() noexcept {
+        std::size_t sent = 0;
+
+        while (!closed && sent < outgoing.size()){
+            long count = socket.send_some(outgoing.data() + sent, outgoing.size() - sent);
+
+            if (count < 0){
+                closed = true;
+            }
+            else if (count == 0){
+                break;
+            }
+
+            sent += static_cast<std::size_t>(std::max(count, 0L));
+        }
+
+        bytesSent += sent;
+        outgoing.erase(outgoing.begin(), outgoing.begin() + static_cast<std::ptrdiff_t>(sent));
+        return !closed;
+    }
+
+    /**
+    * read everything available now, false once the connection is gone.
+    */
+    bool fill() {
+        std::uint8_t buffer[4096];
+
+        while (!closed){
+            long count = socket.receive_some(buffer, sizeof(buffer));
+
+            if (count < 0){
+                closed = true;
+            }
+            else if (count == 0){
+                break;
+            }
+            else {
+                incoming.insert(incoming.end(), buffer, buffer + count);
+                bytesReceived += static_cast<std::uint64_t>(count);
+            }
+        }
+
+        return !closed;
+    }
+
+    /**
+    * bytes received some other way (a reader thread), to be parsed like fill()'s.
+    */
+    void append_incoming(const std::uint8_t* data, std::size_t size) {
+        incoming.insert(incoming.end(), data, data + size);
+        bytesReceived += size;
+    }
+
+    /**
+    * call visit(type, payload, payloadSize) for every complete frame received, in order.
+    */
+    template <typename Visit>
+    void for_each_frame(Visit&& visit) {
+        std::size_t offset = 0;
+
+        while (incoming.size() - offset >= 3){
+            std::size_t size = incoming[offset] | static_cast<std::size_t>(incoming[offset + 1]) << 8;
+
+            if (size == 0){
+                closed = true;
+                break;
+            }
+
+            if (incoming.size() - offset - 2 < size){
+                break;
+            }
+
+            visit(incoming[offset + 2], incoming.data() + offset + 3, size - 1);
+            offset += 2 + size;
+        }
+
+        incoming.erase(incoming.begin(), incoming.begin() + static_cast<std::ptrdiff_t>(offset));
+    }
+};
+
+#endif
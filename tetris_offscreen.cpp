@@ -0,0 +1,409 @@
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <exception>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "tetris_core.hpp"
+#include "tetris_render.hpp"
+#include "tetris_raster.hpp"
+#include "tetris_replay.hpp"
+
+/**
+ * headless rendering: play a deterministic game and draw every frame into memory, no
+ * window and no video driver needed. frames can be dumped as PPM images, compared with
+ * golden images, and the render path is timed.
+ *
+ * usage: tetris-offscreen [--backend sdl|raster] [--scale N] [--seed N] [--frames N]
+ *                         [--replay replay-file] [--dump dir] [--golden dir] [--every N]
+ *                         [--tolerance N]
+ *
+ * the sdl backend draws with TetrisRenderer into SDL_CreateSoftwareRenderer() on an
+ * ARGB8888 surface, the raster backend with TetrisRasterizer, so both paths of the game
+ * can be checked. every frame is one step of the game, a random key (like tetris-batch
+ * --random) or the next event of the first record of the replay. a lost random game
+ * goes on with the next seed.
+ *
+ * every N-th frame is written to dir/frame-NNNNNN.ppm with --dump, and compared with the
+ * file of the same name in the --golden dir, where a pixel matches if no channel is off
+ * by more than the tolerance. the exit status is 1 if any frame does not match.
+ *
+ * only the drawing is timed, the JSON report gives that
+ * as frames and pixels per second.
+*/
+
+using namespace std::string_literals;
+
+struct OffscreenOptions {
+    std::string backend = "sdl";
+    int scale = 1;
+    std::uint32_t seed = 0;
+    long frames = 1000;
+    std::string replayPath;
+    std::string dumpDir;
+    std::string goldenDir;
+    long every = 1;
+    int tolerance = 0;
+};
+
+/**
+ * somewhere to draw a frame to, with its ARGB8888 pixels readable afterwards.
+*/
+class OffscreenTarget {
+public:
+    virtual ~OffscreenTarget() = default;
+
+    virtual void render(const TetrisGame& game) = 0;
+
+    virtual int get_width() const noexcept = 0;
+    virtual int get_height() const noexcept = 0;
+
+    /**
+    * pixel row y of the frame drawn last.
+    */
+    virtual const std::uint32_t* get_row(int y) const noexcept = 0;
+};
+
+class SdlOffscreenTarget : public OffscreenTarget {
+    SDL_Surface* surface = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    std::unique_ptr<TetrisRenderer> tetrisRenderer;
+public:
+    explicit SdlOffscreenTarget(int scale) {
+        surface = SDL_CreateRGBSurfaceWithFormat(0, TETRIS_WIDTH * BLOCK_WIDTH * scale, TETRIS_HEIGHT * BLOCK_WIDTH * scale, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (surface == nullptr){
+            throw std::runtime_error{ "create surface failed: "s + SDL_GetError() };
+        }
+
+        renderer = SDL_CreateSoftwareRenderer(surface);
+        if (renderer == nullptr){
+            SDL_FreeSurface(surface);
+            throw std::runtime_error{ "create software renderer failed: "s + SDL_GetError() };
+        }
+
+        SDL_RenderSetScale(renderer, static_cast<float>(scale), static_cast<float>(scale));
+        tetrisRenderer = std::make_unique<TetrisRenderer>(renderer);
+    }
+
+    SdlOffscreenTarget(SdlOffscreenTarget const&) = delete;
+    SdlOffscreenTarget& operator=(SdlOffscreenTarget const&) = delete;
+
+    ~SdlOffscreenTarget() noexcept override {
+        tetrisRenderer.reset();
+        SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+    }
+
+    void render(const TetrisGame& game) override {
+        tetrisRenderer->render(game);
+
+        // the renderer may batch its commands, they must reach the surface before it is read.
+        SDL_RenderFlush(renderer);
+    }
+
+    int get_width() const noexcept override {
+        return surface->w;
+    }
+
+    int get_height() const noexcept override {
+        return surface->h;
+    }
+
+    const std::uint32_t* get_row(int y) const noexcept override {
+        return reinterpret_cast<const std::uint32_t*>(static_cast<const std::uint8_t*>(surface->pixels) + static_cast<std::size_t>(y) * surface->pitch);
+    }
+};
+
+class RasterOffscreenTarget : public OffscreenTarget {
+    TetrisRasterizer rasterizer;
+public:
+    explicit RasterOffscreenTarget(int scale)
+        : rasterizer{ scale }
+    {}
+
+    void render(const TetrisGame& game) override {
+        rasterizer.render(game);
+    }
+
+    int get_width() const noexcept override {
+        return rasterizer.get_width();
+    }
+
+    int get_height() const noexcept override {
+        return rasterizer.get_height();
+    }
+
+    const std::uint32_t* get_row(int y) const noexcept override {
+        return rasterizer.get_pixels() + static_cast<std::size_t>(y) * rasterizer.get_width();
+    }
+};
+
+/**
+ * a frame as 8-bit RGB, what a P6 PPM holds.
+*/
+std::vector<std::uint8_t> to_rgb(OffscreenTarget const& target) {
+    std::vector<std::uint8_t> rgb;
+    rgb.reserve(static_cast<std::size_t>(target.get_width()) * target.get_height() * 3);
+
+    for (int y = 0; y < target.get_height(); ++y){
+        const std::uint32_t* row = target.get_row(y);
+
+        for (int x = 0; x < target.get_width(); ++x){
+            rgb.push_back(static_cast<std::uint8_t>(row[x] >> 16));
+            rgb.push_back(static_cast<std::uint8_t>(row[x] >> 8));
+            rgb.push_back(static_cast<std::uint8_t>(row[x]));
+        }
+    }
+
+    return rgb;
+}
+
+void write_ppm(std::string const& path, int width, int height, std::vector<std::uint8_t> const& rgb) {
+    std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+
+    if (!file){
+        throw std::runtime_error{ "write image failed: " + path };
+    }
+}
+
+/**
+ * read a binary (P6) PPM with 8-bit channels, returns false if the file can't be opened.
+*/
+bool read_ppm(std::string const& path, int& width, int& height, std::vector<std::uint8_t>& rgb) {
+    std::ifstream file{ path, std::ios::binary };
+    if (!file){
+        return false;
+    }
+
+    // the header is whitespace separated, and may have '#' comments between its fields.
+    auto next_field = [&file, &path]() {
+        std::string field;
+
+        while (file >> field && field[0] == '#'){
+            std::string comment;
+            std::getline(file, comment);
+        }
+
+        if (!file){
+            throw std::runtime_error{ "bad image header: " + path };
+        }
+
+        return field;
+    };
+
+    std::string magic = next_field();
+    width = std::stoi(next_field());
+    height = std::stoi(next_field());
+    int maxValue = std::stoi(next_field());
+
+    if (magic != "P6" || width <= 0 || height <= 0 || maxValue != 255){
+        throw std::runtime_error{ "unsupported image (8-bit P6 only): " + path };
+    }
+
+    // a single whitespace byte ends the header.
+    file.get();
+
+    rgb.resize(static_cast<std::size_t>(width) * height * 3);
+    if (!file.read(reinterpret_cast<char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()))){
+        throw std::runtime_error{ "truncated image: " + path };
+    }
+
+    return true;
+}
+
+/**
+ * how many pixels are off by more than tolerance in some channel.
+*/
+long count_mismatched_pixels(std::vector<std::uint8_t> const& a, std::vector<std::uint8_t> const& b, int tolerance) {
+    long mismatched = 0;
+
+    for (std::size_t i = 0; i + 2 < a.size(); i += 3){
+        if (std::abs(a[i] - b[i]) > tolerance
+            || std::abs(a[i + 1] - b[i + 1]) > tolerance
+            || std::abs(a[i + 2] - b[i + 2]) > tolerance){
+            ++mismatched;
+        }
+    }
+
+    return mismatched;
+}
+
+std::string frame_name(long frame) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame-%06ld.ppm", frame);
+    return name;
+}
+
+OffscreenOptions parse_options(int argc, char* argv[]) {
+    OffscreenOptions options;
+
+    for (int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--backend" && hasValue){
+            options.backend = argv[++i];
+        }
+        else if (arg == "--scale" && hasValue){
+            options.scale = std::stoi(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue){
+            options.seed = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--frames" && hasValue){
+            options.frames = std::stol(argv[++i]);
+        }
+        else if (arg == "--replay" && hasValue){
+            options.replayPath = argv[++i];
+        }
+        else if (arg == "--dump" && hasValue){
+            options.dumpDir = argv[++i];
+        }
+        else if (arg == "--golden" && hasValue){
+            options.goldenDir = argv[++i];
+        }
+        else if (arg == "--every" && hasValue){
+            options.every = std::stol(argv[++i]);
+        }
+        else if (arg == "--tolerance" && hasValue){
+            options.tolerance = std::stoi(argv[++i]);
+        }
+        else {
+            throw std::runtime_error{ "unknown option: "s + arg };
+        }
+    }
+
+    if (options.backend != "sdl" && options.backend != "raster"){
+        throw std::runtime_error{ "unknown backend: " + options.backend };
+    }
+
+    if (options.scale <= 0 || options.frames <= 0 || options.every <= 0){
+        throw std::runtime_error{ "--scale, --frames and --every must be positive" };
+    }
+
+    return options;
+}
+
+int main(int argc, char* argv[]){
+    try {
+        OffscreenOptions options = parse_options(argc, argv);
+
+        std::unique_ptr<OffscreenTarget> target;
+        if (options.backend == "sdl"){
+            target = std::make_unique<SdlOffscreenTarget>(options.scale);
+        }
+        else {
+            target = std::make_unique<RasterOffscreenTarget>(options.scale);
+        }
+
+        // the actions of the whole run, decided up front so only drawing happens in the loop.
+        std::vector<Action> actions;
+        std::uint32_t seed = options.seed;
+        std::unique_ptr<ReplayFile> replayFile;
+
+        if (!options.replayPath.empty()){
+            replayFile = std::make_unique<ReplayFile>(options.replayPath);
+            if (replayFile->get_records().empty()){
+                throw std::runtime_error{ "empty replay: " + options.replayPath };
+            }
+
+            ReplayRecord const& record = replayFile->get_records().front();
+            seed = record.seed;
+            record.for_each_event([&actions, &options](ReplayEvent const& event) {
+                if (static_cast<long>(actions.size()) < options.frames){
+                    actions.push_back(event.action);
+                }
+            });
+        }
+        else {
+            std::mt19937 mt{ seed };
+            for (long i = 0; i < options.frames; ++i){
+                actions.push_back(static_cast<Action>(1 + mt() % 4));
+            }
+        }
+
+        TetrisGame game{ seed };
+        std::vector<std::uint8_t> golden;
+        long dumped = 0;
+        long compared = 0;
+        long mismatches = 0;
+        double renderSeconds = 0;
+        long frames = 0;
+
+        for (Action action : actions){
+            if (game.is_game_over()){
+                if (replayFile != nullptr){
+                    break;
+                }
+
+                game = TetrisGame{ ++seed };
+            }
+
+            game.step(action);
+
+            auto start = std::chrono::steady_clock::now();
+            target->render(game);
+            renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (frames % options.every == 0 && (!options.dumpDir.empty() || !options.goldenDir.empty())){
+                std::vector<std::uint8_t> rgb = to_rgb(*target);
+                std::string name = frame_name(frames);
+
+                if (!options.dumpDir.empty()){
+                    write_ppm(options.dumpDir + "/" + name, target->get_width(), target->get_height(), rgb);
+                    ++dumped;
+                }
+
+                if (!options.goldenDir.empty()){
+                    int goldenWidth = 0;
+                    int goldenHeight = 0;
+                    ++compared;
+
+                    if (!read_ppm(options.goldenDir + "/" + name, goldenWidth, goldenHeight, golden)){
+                        std::cerr << name << ": no golden image\n";
+                        ++mismatches;
+                    }
+                    else if (goldenWidth != target->get_width() || goldenHeight != target->get_height()){
+                        std::cerr << name << ": golden image is " << goldenWidth << "x" << goldenHeight << "\n";
+                        ++mismatches;
+                    }
+                    else if (long bad = count_mismatched_pixels(rgb, golden, options.tolerance)){
+                        std::cerr << name << ": " << bad << " pixels differ\n";
+                        ++mismatches;
+                    }
+                }
+            }
+
+            ++frames;
+        }
+
+        double pixels = static_cast<double>(target->get_width()) * target->get_height() * frames;
+
+        std::cout << "{\n"
+                  << "  \"backend\": \"" << options.backend << "\",\n"
+                  << "  \"scale\": " << options.scale << ",\n"
+                  << "  \"width\": " << target->get_width() << ",\n"
+                  << "  \"height\": " << target->get_height() << ",\n"
+                  << "  \"frames\": " << frames << ",\n"
+                  << "  \"render_seconds\": " << renderSeconds << ",\n"
+                  << "  \"frames_per_second\": " << (renderSeconds > 0 ? frames / renderSeconds : 0) << ",\n"
+                  << "  \"pixels_per_second\": " << (renderSeconds > 0 ? pixels / renderSeconds : 0) << ",\n"
+                  << "  \"dumped\": " << dumped << ",\n"
+                  << "  \"compared\": " << compared << ",\n"
+                  << "  \"mismatches\": " << mismatches << "\n"
+                  << "}\n";
+
+        return mismatches == 0 ? 0 : 1;
+    }
+    catch(std::exception const& e){
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,383 @@
+#include <iostream>
+#include <exception>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "tetris_core.hpp"
+#include "tetris_scheduler.hpp"
+
+/**
+ * perft for the movement rules: count every distinct position a fixed sequence of blocks
+ * can lock in, to a given depth, and how fast that goes.
+ *
+ * usage: tetris-perft [--pieces TIOLJSZ] [--depth N] [--threads N] [--map board-file] [--board WxH]
+ *                     [--divide] [--expect N]
+ *
+ * block d of the sequence (repeated if depth is longer) spawns where the game spawns it,
+ * unrotated, and every key sequence of Left, Right, Rotate and Down is explored with
+ * try_move(), the rules TetrisGame plays by, so slides under overhangs (tucks) and
+ * rotations into a hole (spins) count too, not only straight drops. a block locks where
+ * Down is blocked, as in move_down(). two lock positions covering the same four cells are
+ * the same placement. the board that follows has its lines cleared, and a lock that
+ * reaches into the extra rows ends the game there.
+ *
+ * --map loads a board from a text file, one line per row, the last line is the bottom one:
+ * '.' or ' ' is an empty cell, anything else a full one. --divide also prints the count
+ * under every first placement, to find which one a change broke. --expect exits with 1
+ * if the count at depth N isn't that, for scripts that check a change of the rules.
+ *
+ * the first placements are spread over the threads.
+*/
+
+using namespace std::string_literals;
+
+struct PerftOptions {
+    std::string pieces = "TIOLJSZ";
+    int depth = 3;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    std::string mapPath;
+    std::string board = "16x28";
+    bool divide = false;
+    long long expect = -1;
+};
+
+/**
+ * the distinct lock positions of one block, found by a flood fill over (rotation, row, column).
+*/
+template <int Width, int Height>
+class PlacementGenerator {
+    using Map = BasicTetrisMap<Width, Height>;
+
+    static constexpr int ROWS = Map::ALL_HEIGHT + TETRIS_FLOOR_ROWS;
+    static constexpr int COLS = BasicPieceMaskTable<Width>::COLS;
+
+    struct Placement {
+        std::uint64_t cells;    // the 4 cell indices, sorted, 16 bits each: the placement's identity.
+        BlockInfo blockInfo;
+    };
+
+    std::vector<std::uint8_t> visited = std::vector<std::uint8_t>(4 * ROWS * COLS);
+    std::vector<BlockInfo> stack;
+    std::vector<Placement> placements;
+
+    std::uint8_t& visited_at(const BlockInfo& blockInfo) noexcept {
+        return visited[(blockInfo.get_rotate_times() * ROWS + blockInfo.get_pos().row) * COLS
+                       + blockInfo.get_pos().col + PIECE_MASK_COL_OFFSET];
+    }
+
+    static std::uint64_t cells_of(const BlockInfo& blockInfo) noexcept {
+        std::array<std::uint64_t, 4> cells;
+        int i = 0;
+
+        blockInfo.for_each_shape_point([&cells, &i](int row, int col) {
+            cells[i++] = static_cast<std::uint64_t>(row * Width + col);
+        });
+
+        std::sort(cells.begin(), cells.end());
+        return cells[0] | cells[1] << 16 | cells[2] << 32 | cells[3] << 48;
+    }
+
+public:
+    /**
+    * every placement of block on tetrisMap, each once. the result lives until the next call.
+    */
+    const std::vector<Placement>& generate(const Map& tetrisMap, Block block) {
+        std::fill(visited.begin(), visited.end(), std::uint8_t{ 0 });
+        placements.clear();
+
+        BlockInfo spawn{ block, 2, Width / 2, 0 };
+        if (tetrisMap.collides(spawn)){
+            return placements;
+        }
+
+        visited_at(spawn) = 1;
+        stack.assign(1, spawn);
+
+        while (!stack.empty()){
+            BlockInfo blockInfo = stack.back();
+            stack.pop_back();
+
+            for (Action action : { Action::Left, Action::Right, Action::Rotate, Action::Down }){
+                BlockInfo next = blockInfo;
+
+                if (!try_move(tetrisMap, next, action)){
+                    if (action == Action::Down){
+                        placements.push_back(Placement{ cells_of(blockInfo), blockInfo });
+                    }
+                    continue;
+                }
+
+                std::uint8_t& seen = visited_at(next);
+                if (seen == 0){
+                    seen = 1;
+                    stack.push_back(next);
+                }
+            }
+        }
+
+        std::sort(placements.begin(), placements.end(), [](Placement const& a, Placement const& b) { return a.cells < b.cells; });
+        placements.erase(std::unique(placements.begin(), placements.end(), [](Placement const& a, Placement const& b) { return a.cells == b.cells; }),
+                         placements.end());
+
+        return placements;
+    }
+};
+
+/**
+ * one generator per depth, as a level's placements are walked while the next is generated.
+*/
+template <int Width, int Height>
+struct alignas(64) PerftWorker {
+    std::vector<PlacementGenerator<Width, Height>> generators;
+    std::vector<long long> counts;      // placements found at each depth.
+};
+
+template <int Width, int Height>
+void perft(PerftWorker<Width, Height>& worker, PerftOptions const& options, const BasicTetrisMap<Width, Height>& tetrisMap, int depth) {
+    Block block = static_cast<Block>(options.pieces[depth % options.pieces.size()]);
+    auto const& placements = worker.generators[depth].generate(tetrisMap, block);
+
+    worker.counts[depth] += static_cast<long long>(placements.size());
+    if (depth + 1 == options.depth){
+        return;
+    }
+
+    for (auto const& placement : placements){
+        BasicTetrisMap<Width, Height> next = tetrisMap;
+        next.lock_block(placement.blockInfo);
+
+        if (next.check_row_is_empty(TETRIS_EXTRA_HEIGHT)){
+            perft(worker, options, next, depth + 1);
+        }
+    }
+}
+
+template <int Width, int Height>
+BasicTetrisMap<Width, Height> load_map(std::string const& path) {
+    using Map = BasicTetrisMap<Width, Height>;
+
+    Map tetrisMap;
+    if (path.empty()){
+        return tetrisMap;
+    }
+
+    std::ifstream file{ path };
+    if (!file){
+        throw std::runtime_error{ "open map failed: " + path };
+    }
+
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);){
+        if (!line.empty() && line.back() == '\r'){
+            line.pop_back();
+        }
+        lines.push_back(line);
+    }
+
+    if (static_cast<int>(lines.size()) > Map::ALL_HEIGHT || std::any_of(lines.begin(), lines.end(), [](std::string const& line) { return static_cast<int>(line.size()) > Width; })){
+        throw std::runtime_error{ "the map doesn't fit a " + std::to_string(Width) + "x" + std::to_string(Height) + " board: " + path };
+    }
+
+    int row = Map::ALL_HEIGHT - static_cast<int>(lines.size());
+    for (std::string const& line : lines){
+        for (int col = 0; col < static_cast<int>(line.size()); ++col){
+            if (line[col] != '.' && line[col] != ' '){
+                tetrisMap.set(row, col, Block::Garbage);
+            }
+        }
+        ++row;
+    }
+
+    return tetrisMap;
+}
+
+PerftOptions parse_options(int argc, char* argv[]) {
+    PerftOptions options;
+
+    for (int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--pieces" && hasValue){
+            options.pieces = argv[++i];
+        }
+        else if (arg == "--depth" && hasValue){
+            options.depth = std::stoi(argv[++i]);
+        }
+        else if (arg == "--threads" && hasValue){
+            options.threads = std::stoi(argv[++i]);
+        }
+        else if (arg == "--map" && hasValue){
+            options.mapPath = argv[++i];
+        }
+        else if (arg == "--board" && hasValue){
+            options.board = argv[++i];
+        }
+        else if (arg == "--divide"){
+            options.divide = true;
+        }
+        else if (arg == "--expect" && hasValue){
+            options.expect = std::stoll(argv[++i]);
+        }
+        else {
+            throw std::runtime_error{ "unknown option: "s + arg };
+        }
+    }
+
+    if (options.depth <= 0){
+        throw std::runtime_error{ "--depth must be positive" };
+    }
+
+    if (options.pieces.empty()){
+        throw std::runtime_error{ "--pieces needs at least one block" };
+    }
+
+    // from letters to Block values, kept in the same string.
+    const std::string names = "IOTSZJL";
+    for (char& piece : options.pieces){
+        std::size_t block = names.find(static_cast<char>(std::toupper(static_cast<unsigned char>(piece))));
+        if (block == std::string::npos){
+            throw std::runtime_error{ "unknown block: "s + piece + ", blocks are " + names };
+        }
+        piece = static_cast<char>(block);
+    }
+
+    if (options.board != "16x28" && options.board != "10x20" && options.board != "32x28" && options.board != "64x28"){
+        throw std::runtime_error{ "unsupported board: " + options.board };
+    }
+
+    return options;
+}
+
+template <int Width, int Height>
+bool run_perft(PerftOptions const& options) {
+    using Map = BasicTetrisMap<Width, Height>;
+
+    Map tetrisMap = load_map<Width, Height>(options.mapPath);
+    WorkStealingScheduler scheduler{ options.threads };
+    std::vector<PerftWorker<Width, Height>> workers(static_cast<std::size_t>(scheduler.get_thread_count()));
+
+    for (auto& worker : workers){
+        worker.generators.resize(static_cast<std::size_t>(options.depth));
+        worker.counts.assign(static_cast<std::size_t>(options.depth), 0);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // the first level here, so that its placements can be split over the threads.
+    PlacementGenerator<Width, Height> rootGenerator;
+    auto const& roots = rootGenerator.generate(tetrisMap, static_cast<Block>(options.pieces[0]));
+    std::vector<long long> divide(roots.size());
+
+    if (options.depth > 1){
+        scheduler.run(static_cast<long>(roots.size()), [&](int w, long index) {
+            PerftWorker<Width, Height>& worker = workers[w];
+            long long before = worker.counts[options.depth - 1];
+
+            Map next = tetrisMap;
+            next.lock_block(roots[index].blockInfo);
+
+            if (next.check_row_is_empty(TETRIS_EXTRA_HEIGHT)){
+                perft(worker, options, next, 1);
+            }
+
+            divide[index] = worker.counts[options.depth - 1] - before;
+        });
+    }
+    else {
+        std::fill(divide.begin(), divide.end(), 1);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<long long> counts(static_cast<std::size_t>(options.depth), 0);
+    counts[0] = static_cast<long long>(roots.size());
+    for (auto const& worker : workers){
+        for (int d = 1; d < options.depth; ++d){
+            counts[d] += worker.counts[d];
+        }
+    }
+
+    long long nodes = 0;
+    for (long long count : counts){
+        nodes += count;
+    }
+
+    const std::string names = "IOTSZJL";
+    std::string pieces;
+    for (char piece : options.pieces){
+        pieces += names[static_cast<std::size_t>(piece)];
+    }
+
+    std::cout << "{\n"
+              << "  \"board\": \"" << Width << "x" << Height << "\",\n"
+              << "  \"pieces\": \"" << pieces << "\",\n"
+              << "  \"depth\": " << options.depth << ",\n"
+              << "  \"threads\": " << scheduler.get_thread_count() << ",\n"
+              << "  \"perft\": " << counts.back() << ",\n"
+              << "  \"counts\": [";
+
+    for (int d = 0; d < options.depth; ++d){
+        std::cout << (d == 0 ? " " : ", ") << counts[d];
+    }
+
+    std::cout << " ],\n"
+              << "  \"nodes\": " << nodes << ",\n"
+              << "  \"seconds\": " << seconds << ",\n"
+              << "  \"nodes_per_second\": " << static_cast<double>(nodes) / seconds;
+
+    if (options.divide){
+        std::cout << ",\n  \"divide\": [";
+
+        for (std::size_t i = 0; i < roots.size(); ++i){
+            BlockInfo const& blockInfo = roots[i].blockInfo;
+
+            std::cout << (i == 0 ? "\n" : ",\n")
+                      << "    { \"rotation\": " << blockInfo.get_rotate_times()
+                      << ", \"row\": " << blockInfo.get_pos().row
+                      << ", \"col\": " << blockInfo.get_pos().col
+                      << ", \"nodes\": " << divide[i] << " }";
+        }
+
+        std::cout << "\n  ]";
+    }
+
+    std::cout << "\n}\n";
+
+    if (options.expect >= 0 && counts.back() != options.expect){
+        std::cerr << "perft " << counts.back() << ", expected " << options.expect << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    try {
+        PerftOptions options = parse_options(argc, argv);
+        bool passed;
+
+        if (options.board == "10x20"){
+            passed = run_perft<10, 20>(options);
+        }
+        else if (options.board == "32x28"){
+            passed = run_perft<32, 28>(options);
+        }
+        else if (options.board == "64x28"){
+            passed = run_perft<64, 28>(options);
+        }
+        else {
+            passed = run_perft<TETRIS_WIDTH, TETRIS_HEIGHT>(options);
+        }
+
+        return passed ? 0 : 1;
+    }
+    catch(std::exception const& e){
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
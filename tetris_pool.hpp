@@ -0,0 +1,397 @@
+#ifndef TETRIS_POOL_HPP
+#define TETRIS_POOL_HPP
+
+/**
+ * many games in one object, for a server running thousands of sessions per core.
+ *
+ * a TetrisGame is self-contained: its board, its block and a std::mt19937 (5 KB of its
+ * 5.6 KB with 64-bit libstdc++).
+ * a session pool instead keeps every field of every session in its own array (structure
+ * of arrays): the occupancy rows of all boards back to back, the block kinds, rows,
+ * columns and rotations in narrow integer arrays, and one 8-byte random state per session.
+ * a session is a slot index into these arrays.
+ *
+ * tick() advances every session by one action. it runs in two passes: the first only
+ * moves blocks, a mask lookup and 4 ANDs per session over densely packed arrays; blocks
+ * that landed are only collected. the second pass locks those (about one session in
+ * twenty per tick), clears lines and spawns the next block.
+ *
+ * the rules are the ones of TetrisGame, but the blocks come from SessionRng rather than
+ * std::mt19937, so a session is a different game than a TetrisGame with the same seed.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "tetris_core.hpp"
+
+/**
+ * a PCG32 generator (XSH-RR output of a 64-bit LCG): 8 bytes of state instead of the
+ * 5 KB of std::mt19937, and good enough to deal blocks.
+*/
+class SessionRng {
+    static constexpr std::uint64_t MULTIPLIER = 6364136223846793005ull;
+    static constexpr std::uint64_t INCREMENT = 1442695040888963407ull;
+public:
+    static std::uint64_t seed_state(std::uint32_t seed) noexcept {
+        std::uint64_t state = 0;
+        next(state);
+        state += seed;
+        next(state);
+        return state;
+    }
+
+    static std::uint32_t next(std::uint64_t& state) noexcept {
+        std::uint64_t old = state;
+        state = old * MULTIPLIER + INCREMENT;
+
+        std::uint32_t xorShifted = static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27);
+        std::uint32_t rotation = static_cast<std::uint32_t>(old >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    /**
+    * a number in [0, bound), by multiply and shift instead of a division.
+    */
+    static std::uint32_t next_below(std::uint64_t& state, std::uint32_t bound) noexcept {
+        return static_cast<std::uint32_t>((static_cast<std::uint64_t>(next(state)) * bound) >> 32);
+    }
+};
+
+template <int Width, int Height>
+class BasicSessionPool {
+public:
+    using Map = BasicTetrisMap<Width, Height>;
+    using Row = typename Map::Row;
+
+    // every board is its visible and extra rows, then the full floor rows.
+    static constexpr int BOARD_ROWS = Map::ALL_HEIGHT + TETRIS_FLOOR_ROWS;
+private:
+    int capacity;
+    int sessionCount = 0;
+
+    // the planes of every board, session s starts at s * BOARD_ROWS (rows) and s * Map::ALL_HEIGHT * Width (colors).
+    std::vector<Row> rows;
+    std::vector<std::uint8_t> colors;
+
+    // the current block of every session.
+    std::vector<std::uint8_t> blocks;
+    std::vector<std::uint8_t> rotations;
+    std::vector<std::int8_t> blockRows;
+    std::vector<std::int8_t> blockCols;
+
+    std::vector<std::uint64_t> rngStates;
+    std::vector<std::int32_t> linesCleared;
+    std::vector<std::int32_t> piecesPlaced;
+    std::vector<std::uint8_t> gameOver;
+
+    // sessions whose block landed in the current tick.
+    std::vector<int> landed;
+
+    Row* board_rows(int session) noexcept {
+        return rows.data() + static_cast<std::size_t>(session) * BOARD_ROWS;
+    }
+
+    const Row* board_rows(int session) const noexcept {
+        return rows.data() + static_cast<std::size_t>(session) * BOARD_ROWS;
+    }
+
+    std::uint8_t* board_colors(int session, int row) noexcept {
+        return colors.data() + (static_cast<std::size_t>(session) * Map::ALL_HEIGHT + row) * Width;
+    }
+
+    const std::uint8_t* board_colors(int session, int row) const noexcept {
+        return colors.data() + (static_cast<std::size_t>(session) * Map::ALL_HEIGHT + row) * Width;
+    }
+
+    static const BasicPieceMask<Row>& mask_of(int block, int rotation, int col) noexcept {
+        return pieceMaskTableFor<Width>.masks[block][rotation][col + PIECE_MASK_COL_OFFSET];
+    }
+
+    /**
+    * the same test as BasicTetrisMap::collides().
+    */
+    static bool collides(const Row* boardRows, const BasicPieceMask<Row>& mask, int row) noexcept {
+        const Row* r = boardRows + row + mask.top;
+
+        return !mask.inBounds
+            || ((r[0] & mask.rows[0]) | (r[1] & mask.rows[1]) | (r[2] & mask.rows[2]) | (r[3] & mask.rows[3])) != 0;
+    }
+
+    void spawn_block(int session) noexcept {
+        std::uint64_t& state = rngStates[session];
+
+        // the same draw order as TetrisGame: the kind first, then the rotation.
+        blocks[session] = static_cast<std::uint8_t>(SessionRng::next_below(state, 7));
+        rotations[session] = static_cast<std::uint8_t>(SessionRng::next_below(state, 4));
+        blockRows[session] = 2;
+        blockCols[session] = static_cast<std::int8_t>(Width / 2);
+    }
+
+    /**
+    * the first pass of tick(): one move, and a note of the session if its block landed.
+    */
+    void move(int session, Action action) noexcept {
+        if (gameOver[session]){
+            return;
+        }
+
+        const Row* boardRows = board_rows(session);
+        int block = blocks[session];
+        int rotation = rotations[session];
+        int row = blockRows[session];
+        int col = blockCols[session];
+
+        switch (action) {
+            case Action::Left:
+                if (!collides(boardRows, mask_of(block, rotation, col - 1), row)){
+                    blockCols[session] = static_cast<std::int8_t>(col - 1);
+                }
+                break;
+            case Action::Right:
+                if (!collides(boardRows, mask_of(block, rotation, col + 1), row)){
+                    blockCols[session] = static_cast<std::int8_t>(col + 1);
+                }
+                break;
+            case Action::Rotate:
+                if (!collides(boardRows, mask_of(block, (rotation + 1) % 4, col), row)){
+                    rotations[session] = static_cast<std::uint8_t>((rotation + 1) % 4);
+                }
+                break;
+            case Action::Down:
+            case Action::Gravity:
+                if (!collides(boardRows, mask_of(block, rotation, col), row + 1)){
+                    blockRows[session] = static_cast<std::int8_t>(row + 1);
+                }
+                else {
+                    landed.push_back(session);
+                }
+                break;
+            case Action::HardDrop: {
+                // the pool keeps no column tops, the rows are stepped down instead.
+                const auto& mask = mask_of(block, rotation, col);
+                while (!collides(boardRows, mask, row + 1)){
+                    ++row;
+                }
+                blockRows[session] = static_cast<std::int8_t>(row);
+                landed.push_back(session);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    /**
+    * the second pass of tick(): what BasicTetrisMap::lock_block() and TetrisGame::move_down()
+    * do after a blocked Down.
+    */
+    void lock(int session) noexcept {
+        Row* boardRows = board_rows(session);
+        BlockInfo blockInfo = get_block_info(session);
+
+        blockInfo.for_each_shape_point([&](int row, int col) {
+            boardRows[row] |= static_cast<Row>(Row{ 1 } << col);
+            board_colors(session, row)[col] = blocks[session];
+        });
+
+        int topRow = blockInfo.get_pos().row + blockInfo.get_mask<Width>().top;
+        linesCleared[session] += eliminate_lines(session, topRow, topRow + 3);
+        ++piecesPlaced[session];
+
+        if (boardRows[TETRIS_EXTRA_HEIGHT] != 0){
+            gameOver[session] = 1;
+        }
+
+        spawn_block(session);
+    }
+
+    /**
+    * BasicTetrisMap::eliminate_lines() on one board of the pool, returns how many lines went.
+    */
+    int eliminate_lines(int session, int topRow, int bottomRow) noexcept {
+        Row* boardRows = board_rows(session);
+        int clearedRows[4];
+        int count = 0;
+
+        for (int r = std::min(bottomRow, Map::ALL_HEIGHT - 1); r >= topRow; --r){
+            if (boardRows[r] == Map::FULL_ROW){
+                clearedRows[count++] = r;
+            }
+        }
+
+        if (count == 0){
+            return 0;
+        }
+
+        int toRow = clearedRows[0];
+        int nextCleared = 1;
+        int fromRow = toRow - 1;
+
+        for (; fromRow >= 0 && boardRows[fromRow] != 0; --fromRow){
+            if (nextCleared < count && fromRow == clearedRows[nextCleared]){
+                ++nextCleared;
+            }
+            else {
+                boardRows[toRow] = boardRows[fromRow];
+                std::copy(board_colors(session, fromRow), board_colors(session, fromRow) + Width, board_colors(session, toRow));
+                --toRow;
+            }
+        }
+
+        for (; toRow > fromRow; --toRow){
+            boardRows[toRow] = 0;
+        }
+
+        return count;
+    }
+public:
+    /**
+    * room for capacity sessions, allocated once: adding sessions never moves the arrays.
+    */
+    explicit BasicSessionPool(int _capacity)
+        : capacity{ std::max(_capacity, 1) },
+          rows(static_cast<std::size_t>(capacity) * BOARD_ROWS),
+          colors(static_cast<std::size_t>(capacity) * Map::ALL_HEIGHT * Width),
+          blocks(capacity), rotations(capacity), blockRows(capacity), blockCols(capacity),
+          rngStates(capacity), linesCleared(capacity), piecesPlaced(capacity), gameOver(capacity)
+    {
+        landed.reserve(capacity);
+    }
+
+    int get_capacity() const noexcept {
+        return capacity;
+    }
+
+    int get_session_count() const noexcept {
+        return sessionCount;
+    }
+
+    /**
+    * start a new session, returns its index.
+    */
+    int add_session(std::uint32_t seed) {
+        if (sessionCount == capacity){
+            throw std::length_error{ "session pool is full" };
+        }
+
+        reset_session(sessionCount, seed);
+        return sessionCount++;
+    }
+
+    /**
+    * start a brand new game in an existing session, such as one that is over.
+    */
+    void reset_session(int session, std::uint32_t seed) noexcept {
+        Row* boardRows = board_rows(session);
+        std::fill(boardRows, boardRows + Map::ALL_HEIGHT, Row{ 0 });
+        std::fill(boardRows + Map::ALL_HEIGHT, boardRows + BOARD_ROWS, Map::FULL_ROW);
+
+        rngStates[session] = SessionRng::seed_state(seed);
+        linesCleared[session] = 0;
+        piecesPlaced[session] = 0;
+        gameOver[session] = 0;
+        spawn_block(session);
+    }
+
+    /**
+    * advance every session by one action, actions[s] is for session s.
+    * sessions that are over ignore it, like TetrisGame::step().
+    */
+    void tick(const Action* actions) noexcept {
+        landed.clear();
+
+        for (int s = 0; s < sessionCount; ++s){
+            move(s, actions[s]);
+        }
+
+        for (int session : landed){
+            lock(session);
+        }
+    }
+
+    /**
+    * advance every session by the same action, such as a gravity tick for all.
+    */
+    void tick(Action action) noexcept {
+        landed.clear();
+
+        for (int s = 0; s < sessionCount; ++s){
+            move(s, action);
+        }
+
+        for (int session : landed){
+            lock(session);
+        }
+    }
+
+    bool is_game_over(int session) const noexcept {
+        return gameOver[session] != 0;
+    }
+
+    int get_lines_cleared(int session) const noexcept {
+        return linesCleared[session];
+    }
+
+    int get_pieces_placed(int session) const noexcept {
+        return piecesPlaced[session];
+    }
+
+    BlockInfo get_block_info(int session) const noexcept {
+        return BlockInfo{ static_cast<Block>(blocks[session]), blockRows[session], blockCols[session], rotations[session] };
+    }
+
+    /**
+    * the kind of block the session will get after the current one.
+    */
+    Block get_next_block(int session) const noexcept {
+        std::uint64_t state = rngStates[session];
+        return static_cast<Block>(SessionRng::next_below(state, 7));
+    }
+
+    /**
+    * the sessions whose block landed during the last tick(), the only ones whose board,
+    * lines or game over can have changed.
+    */
+    const std::vector<int>& get_landed() const noexcept {
+        return landed;
+    }
+
+    Row get_row(int session, int row) const noexcept {
+        return board_rows(session)[row];
+    }
+
+    Block get(int session, int row, int col) const noexcept {
+        return (get_row(session, row) >> col) & 1u ? static_cast<Block>(board_colors(session, row)[col]) : Block::Empty;
+    }
+
+    /**
+    * a copy of one board, to draw it or hand it to code written for TetrisMap.
+    */
+    Map get_map(int session) const noexcept {
+        Map tetrisMap;
+
+        for (int r = 0; r < Map::ALL_HEIGHT; ++r){
+            for (int c = 0; c < Width; ++c){
+                if (get(session, r, c) != Block::Empty){
+                    tetrisMap.set(r, c, get(session, r, c));
+                }
+            }
+        }
+
+        return tetrisMap;
+    }
+
+    /**
+    * memory held per session, for capacity planning.
+    */
+    static constexpr std::size_t get_bytes_per_session() noexcept {
+        return BOARD_ROWS * sizeof(Row) + Map::ALL_HEIGHT * Width
+            + 4 * sizeof(std::uint8_t) + sizeof(std::uint64_t) + 2 * sizeof(std::int32_t) + sizeof(std::uint8_t);
+    }
+};
+
+using SessionPool = BasicSessionPool<TETRIS_WIDTH, TETRIS_HEIGHT>;
+
+#endif
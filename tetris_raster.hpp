@@ -0,0 +1,204 @@
+#ifndef TETRIS_RASTER_HPP
+#define TETRIS_RASTER_HPP
+
+/**
+ * a software rasteriser: draws the board straight into a 32-bit ARGB8888 pixel buffer,
+ * with no renderer in between. the buffer can then be uploaded as a texture in one go
+ * (FramebufferCanvas in tetris_render.hpp) or written to a file.
+ *
+ * the picture is the one TetrisRenderer draws, scaled up by an integer factor: a cell is
+ * scale * BLOCK_WIDTH pixels wide with a scale pixels wide black outline.
+ *
+ * every cell row of the board is built from two scanlines: an outline scanline (all black)
+ * and an inner scanline (each cell's colour between its left and right outline). the inner
+ * one is drawn once with wide span fills, then copied to the other pixel rows of the cell row.
+ * nothing here depends on SDL.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "tetris_core.hpp"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+/**
+ * BLOCK_WIDTH, and the colours of blockColorMap, as ARGB8888 pixels.
+*/
+constexpr int RASTER_BLOCK_WIDTH = 20;
+constexpr std::uint32_t RASTER_BLACK = 0xFF000000u;
+
+constexpr std::uint32_t rasterBlockColors[] = {
+    0xFF39C5BBu,    // I
+    0xFFFFA500u,    // O
+    0xFFFFFF00u,    // T
+    0xFF008000u,    // S
+    0xFFFF0000u,    // Z
+    0xFF0000FFu,    // J
+    0xFF800080u,    // L
+    0xFF808080u     // Garbage
+};
+
+/**
+ * a ghost piece cell: its block's colour at a quarter of the brightness.
+*/
+constexpr std::uint32_t raster_ghost_color(std::uint32_t color) noexcept {
+    return 0xFF000000u | ((color >> 2) & 0x003F3F3Fu);
+}
+
+/**
+ * set count pixels from dst on to value, 8 or 4 at a time where the CPU allows.
+*/
+inline void fill_span(std::uint32_t* dst, int count, std::uint32_t value) noexcept {
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256i wide = _mm256_set1_epi32(static_cast<int>(value));
+    for (; i + 8 <= count; i += 8){
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), wide);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128i wide = _mm_set1_epi32(static_cast<int>(value));
+    for (; i + 4 <= count; i += 4){
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), wide);
+    }
+#endif
+
+    for (; i < count; ++i){
+        dst[i] = value;
+    }
+}
+
+class TetrisRasterizer {
+    int scale;
+    int cellSize;
+    int width;
+    int height;
+    std::vector<std::uint32_t> pixels;
+    bool showGhost = false;
+
+    static std::uint32_t color_of(Block block) noexcept {
+        return block == Block::Empty ? RASTER_BLACK : rasterBlockColors[static_cast<int>(block)];
+    }
+
+    /**
+    * draw board row `row` (a visible row), where cells[c] is the colour of column c,
+    * RASTER_BLACK for an empty cell.
+    */
+    void raster_row(int row, const std::uint32_t (&cells)[TETRIS_WIDTH]) noexcept {
+        std::uint32_t* top = pixels.data() + static_cast<std::size_t>(row - TETRIS_EXTRA_HEIGHT) * cellSize * width;
+
+        // the outline rows above and below the cells are black whatever the cells hold.
+        fill_span(top, scale * width, RASTER_BLACK);
+        fill_span(top + static_cast<std::size_t>(cellSize - scale) * width, scale * width, RASTER_BLACK);
+
+        std::uint32_t* inner = top + static_cast<std::size_t>(scale) * width;
+
+        for (int c = 0; c < TETRIS_WIDTH; ++c){
+            std::uint32_t* cell = inner + c * cellSize;
+
+            if (cells[c] == RASTER_BLACK){
+                fill_span(cell, cellSize, RASTER_BLACK);
+            }
+            else {
+                fill_span(cell, scale, RASTER_BLACK);
+                fill_span(cell + scale, cellSize - 2 * scale, cells[c]);
+                fill_span(cell + cellSize - scale, scale, RASTER_BLACK);
+            }
+        }
+
+        for (int y = 1; y < cellSize - 2 * scale; ++y){
+            std::memcpy(inner + static_cast<std::size_t>(y) * width, inner, width * sizeof(std::uint32_t));
+        }
+    }
+public:
+    explicit TetrisRasterizer(int _scale = 1)
+        : scale{ std::max(_scale, 1) },
+          cellSize{ RASTER_BLOCK_WIDTH * scale },
+          width{ TETRIS_WIDTH * cellSize },
+          height{ TETRIS_HEIGHT * cellSize },
+          pixels(static_cast<std::size_t>(width) * height, RASTER_BLACK)
+    {}
+
+    int get_width() const noexcept {
+        return width;
+    }
+
+    int get_height() const noexcept {
+        return height;
+    }
+
+    int get_cell_size() const noexcept {
+        return cellSize;
+    }
+
+    /**
+    * bytes per pixel row, what SDL_UpdateTexture() calls pitch.
+    */
+    int get_pitch() const noexcept {
+        return width * static_cast<int>(sizeof(std::uint32_t));
+    }
+
+    const std::uint32_t* get_pixels() const noexcept {
+        return pixels.data();
+    }
+
+    /**
+    * draw where the current block would land (ghost_block_info()), in a dark shade of its colour.
+    */
+    void set_ghost(bool show) noexcept {
+        showGhost = show;
+    }
+
+    bool get_ghost() const noexcept {
+        return showGhost;
+    }
+
+    /**
+    * redraw the board rows in rows (only the visible ones count), with the current block on top.
+    */
+    void render_rows(const TetrisMap& tetrisMap, const BlockInfo& blockInfo, DirtyRows rows) noexcept {
+        BlockInfo ghost = showGhost && blockInfo.get_block() != Block::Empty ? ghost_block_info(tetrisMap, blockInfo) : blockInfo;
+        std::uint32_t blockColor = color_of(blockInfo.get_block());
+        std::uint32_t ghostColor = blockColor == RASTER_BLACK ? RASTER_BLACK : raster_ghost_color(blockColor);
+
+        for (int r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
+            if (((rows >> r) & 1u) == 0){
+                continue;
+            }
+
+            std::uint32_t cells[TETRIS_WIDTH];
+            for (int c = 0; c < TETRIS_WIDTH; ++c){
+                cells[c] = color_of(tetrisMap.get(r, c));
+            }
+
+            // the ghost first, the block covers it where they meet.
+            ghost.for_each_shape_point([&cells, ghostColor, r](int row, int col) {
+                if (row == r){
+                    cells[col] = ghostColor;
+                }
+            });
+
+            blockInfo.for_each_shape_point([&cells, blockColor, r](int row, int col) {
+                if (row == r){
+                    cells[col] = blockColor;
+                }
+            });
+
+            raster_row(r, cells);
+        }
+    }
+
+    void render(const TetrisMap& tetrisMap, const BlockInfo& blockInfo) noexcept {
+        render_rows(tetrisMap, blockInfo, ALL_ROWS_DIRTY);
+    }
+
+    void render(const TetrisGame& game) noexcept {
+        render(game.get_map(), game.get_block_info());
+    }
+};
+
+#endif
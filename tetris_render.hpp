@@ -0,0 +1,526 @@
+#ifndef TETRIS_RENDER_HPP
+#define TETRIS_RENDER_HPP
+
+/**
+ * draws a TetrisGame with an SDL_Renderer.
+ *
+ * the renderer may belong to a window or to an offscreen surface
+ * (SDL_CreateSoftwareRenderer), TetrisRenderer doesn't care.
+ *
+ * a frame is drawn in batches: cells are collected first, then filled with one
+ * SDL_RenderFillRects() per colour and outlined with a single SDL_RenderDrawRects(),
+ * instead of four renderer calls per cell. cells never overlap, so the picture is the same.
+ *
+ * render_changes() goes further: drawing into a target that keeps the previous frame
+ * (a texture, see TetrisCanvas), it only redraws the board rows that changed and the
+ * cells the current block left or entered.
+ *
+ * with set_ghost(), where the current block would land is drawn too, in a dark shade of
+ * its colour (ghost_block_info() reads it off the board's column tops).
+*/
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "tetris_core.hpp"
+#include "tetris_raster.hpp"
+
+constexpr int BLOCK_WIDTH = 20;
+
+constexpr SDL_Color COLOR_BLACK = { 0, 0, 0, 255 };
+
+constexpr SDL_Color blockColorMap[] = {
+  // block I RGBA.
+  {  57, 197, 187, 255 },
+  // block O.
+	{ 255, 165,   0, 255 },
+	// block T.
+	{ 255, 255,   0, 255 },
+	// block S.
+	{   0, 128,   0, 255 },
+	// block Z.
+	{ 255,   0,   0, 255 },
+	// block J.
+	{   0,   0, 255, 255 },
+	// block L.
+	{ 128,   0, 128, 255 },
+	// garbage rows, versus mode.
+	{ 128, 128, 128, 255 }
+};
+
+constexpr bool raster_colors_match() {
+    for (int i = 0; i < static_cast<int>(Block::Empty); ++i){
+        SDL_Color const& color = blockColorMap[i];
+        std::uint32_t argb = static_cast<std::uint32_t>(color.a) << 24 | static_cast<std::uint32_t>(color.r) << 16
+                           | static_cast<std::uint32_t>(color.g) << 8 | color.b;
+        if (argb != rasterBlockColors[i]){
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(BLOCK_WIDTH == RASTER_BLOCK_WIDTH && raster_colors_match(), "TetrisRasterizer must draw what TetrisRenderer draws");
+
+/**
+ * a ghost piece cell, the same shade as raster_ghost_color().
+*/
+constexpr SDL_Color ghost_color(SDL_Color color) noexcept {
+    return SDL_Color{ static_cast<Uint8>(color.r >> 2), static_cast<Uint8>(color.g >> 2), static_cast<Uint8>(color.b >> 2), 255 };
+}
+
+class TetrisRenderer {
+    SDL_Renderer* renderer;
+
+    // the visible board plus the current block and its ghost.
+    static constexpr int MAX_CELLS = TETRIS_HEIGHT * TETRIS_WIDTH + 8;
+
+    // a colour per block, then the ghost shade of each.
+    static constexpr int BLOCK_COLOR_COUNT = static_cast<int>(Block::Empty);
+    static constexpr int COLOR_COUNT = 2 * BLOCK_COLOR_COUNT;
+
+    // the cells of the frame being drawn, in the order they were added, then grouped by colour.
+    SDL_Rect cells[MAX_CELLS];
+    int cellColors[MAX_CELLS];
+    SDL_Rect cellsByColor[MAX_CELLS];
+    int cellCount = 0;
+
+    bool showGhost = false;
+
+    // what the target holds since the last render_changes().
+    bool hasPreviousFrame = false;
+    BlockInfo previousBlockInfo;
+    BlockInfo previousGhost;
+
+    // every dirty row is one rect, the block and its ghost add at most 16 single cells (where they were, where they are).
+    SDL_Rect backgrounds[TETRIS_HEIGHT + 16];
+
+    static SDL_Rect cell_rect(int row, int col) noexcept {
+        return SDL_Rect{ 
+            col * BLOCK_WIDTH, 
+            (row - TETRIS_EXTRA_HEIGHT) * BLOCK_WIDTH, 
+            BLOCK_WIDTH, 
+            BLOCK_WIDTH
+        };
+    }
+
+    void add_cell(int row, int col, int color) noexcept {
+        cells[cellCount] = cell_rect(row, col);
+        cellColors[cellCount] = color;
+        ++cellCount;
+    }
+
+    void add_cell(int row, int col, Block block) noexcept {
+        add_cell(row, col, static_cast<int>(block));
+    }
+
+    static SDL_Color color_of(int color) noexcept {
+        return color < BLOCK_COLOR_COUNT ? blockColorMap[color] : ghost_color(blockColorMap[color - BLOCK_COLOR_COUNT]);
+    }
+
+    static bool is_visible(int row) noexcept {
+        return row >= TETRIS_EXTRA_HEIGHT && row < TETRIS_ALL_HEIGHT;
+    }
+
+    /**
+    * the ghost of blockInfo, or blockInfo itself when there is none to draw.
+    */
+    BlockInfo ghost_of(const TetrisMap& tetrisMap, const BlockInfo& blockInfo) const noexcept {
+        return showGhost && blockInfo.get_block() != Block::Empty ? ghost_block_info(tetrisMap, blockInfo) : blockInfo;
+    }
+
+    /**
+    * the visible cells of ghost that blockInfo doesn't cover and drawCell(row, col) accepts.
+    */
+    template <typename DrawCell>
+    void add_ghost_cells(const BlockInfo& ghost, const BlockInfo& blockInfo, DrawCell&& drawCell) noexcept {
+        ghost.for_each_shape_point([&](int row, int col) {
+            bool covered = blockInfo.for_each_shape_point_if([row, col](int blockRow, int blockCol) {
+                return blockRow == row && blockCol == col;
+            });
+
+            if (!covered && is_visible(row) && drawCell(row, col)){
+                add_cell(row, col, BLOCK_COLOR_COUNT + static_cast<int>(ghost.get_block()));
+            }
+        });
+    }
+
+    void add_map_cells(const TetrisMap& tetrisMap) noexcept {
+        for (int r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
+            RowBits row = tetrisMap.get_row(r);
+
+            for (int c = 0; row != 0; ++c, row >>= 1){
+                if (row & 1u){
+                    add_cell(r, c, tetrisMap.get(r, c));
+                }
+            }
+        }
+    }
+
+    /**
+    * draw every collected cell, a counting sort groups them by colour first.
+    */
+    void flush_cells() noexcept {
+        int colorStarts[COLOR_COUNT + 1] = {};
+
+        for (int i = 0; i < cellCount; ++i){
+            ++colorStarts[cellColors[i] + 1];
+        }
+
+        for (int color = 0; color < COLOR_COUNT; ++color){
+            colorStarts[color + 1] += colorStarts[color];
+        }
+
+        int next[COLOR_COUNT];
+        std::copy(colorStarts, colorStarts + COLOR_COUNT, next);
+
+        for (int i = 0; i < cellCount; ++i){
+            cellsByColor[next[cellColors[i]]++] = cells[i];
+        }
+
+        for (int color = 0; color < COLOR_COUNT; ++color){
+            int count = colorStarts[color + 1] - colorStarts[color];
+
+            if (count > 0){
+                SDL_Color fill = color_of(color);
+                SDL_SetRenderDrawColor(renderer, fill.r, fill.g, fill.b, fill.a);
+                SDL_RenderFillRects(renderer, cellsByColor + colorStarts[color], count);
+            }
+        }
+
+        if (cellCount > 0){
+            SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
+            SDL_RenderDrawRects(renderer, cells, cellCount);
+        }
+
+        cellCount = 0;
+    }
+public:
+    explicit TetrisRenderer(SDL_Renderer* _renderer)
+        : renderer{ _renderer }
+    {}
+
+    /**
+    * draw a single cell right away, prefer render() for whole frames.
+    */
+    void render_block(int row, int col, Block block) noexcept {
+        SDL_Color const& color = blockColorMap[static_cast<int>(block)];
+        SDL_Rect rect = cell_rect(row, col);
+
+        // render a filled rectangle.
+        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+        SDL_RenderFillRect(renderer, &rect);
+
+        // render a outlined rectangle.
+        SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
+        SDL_RenderDrawRect(renderer, &rect);
+    }
+
+    /**
+    * draw where the current block would land, see ghost_block_info().
+    */
+    void set_ghost(bool show) noexcept {
+        showGhost = show;
+        hasPreviousFrame = false;
+    }
+
+    void render_map(const TetrisMap& tetrisMap) noexcept {
+        add_map_cells(tetrisMap);
+        flush_cells();
+    }
+
+    /**
+    * draw the whole frame, it's up to the caller to present it.
+    */
+    void render(const TetrisMap& tetrisMap, const BlockInfo& blockInfo) noexcept {
+        // using black color to clear the screen first.
+        SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
+        SDL_RenderClear(renderer);
+
+        add_map_cells(tetrisMap);
+        add_ghost_cells(ghost_of(tetrisMap, blockInfo), blockInfo, [](int, int) { return true; });
+
+        blockInfo.for_each_shape_point([this, &blockInfo] (int row, int col) {
+            add_cell(row, col, blockInfo.get_block());
+        });
+
+        flush_cells();
+    }
+
+    void render(const TetrisGame& game) noexcept {
+        render(game.get_map(), game.get_block_info());
+    }
+
+    /**
+    * bring the frame left in the render target by the previous call up to date.
+    * dirtyRows are the board rows changed since then (TetrisGame::take_dirty_rows()),
+    * the block is compared with the previous one here. returns false when nothing changed,
+    * and so nothing was drawn. the first call, or the first after invalidate(), draws everything.
+    */
+    bool render_changes(const TetrisMap& tetrisMap, const BlockInfo& blockInfo, DirtyRows dirtyRows) noexcept {
+        RowBits dirtyCells[TETRIS_ALL_HEIGHT] = {};
+
+        if (!hasPreviousFrame){
+            dirtyRows = ALL_ROWS_DIRTY;
+        }
+
+        for (int r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
+            if ((dirtyRows >> r) & 1u){
+                dirtyCells[r] = TETRIS_FULL_ROW;
+            }
+        }
+
+        auto markCell = [&dirtyCells](int row, int col) {
+            if (is_visible(row)){
+                dirtyCells[row] |= static_cast<RowBits>(1u << col);
+            }
+        };
+
+        if (!hasPreviousFrame || !same_place(previousBlockInfo, blockInfo)){
+            if (hasPreviousFrame){
+                previousBlockInfo.for_each_shape_point(markCell);
+            }
+
+            blockInfo.for_each_shape_point(markCell);
+        }
+
+        // the ghost moves with the block, and with the board under it.
+        BlockInfo ghost = ghost_of(tetrisMap, blockInfo);
+        if (!hasPreviousFrame || !same_place(previousGhost, ghost)){
+            if (hasPreviousFrame){
+                previousGhost.for_each_shape_point(markCell);
+            }
+
+            ghost.for_each_shape_point(markCell);
+        }
+
+        hasPreviousFrame = true;
+        previousBlockInfo = blockInfo;
+        previousGhost = ghost;
+
+        // wipe what changed back to the background, a whole row at once where possible.
+        int backgroundCount = 0;
+
+        for (int r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
+            if (dirtyCells[r] == TETRIS_FULL_ROW){
+                SDL_Rect rect = cell_rect(r, 0);
+                rect.w = TETRIS_WIDTH * BLOCK_WIDTH;
+                backgrounds[backgroundCount++] = rect;
+                continue;
+            }
+
+            RowBits cellBits = dirtyCells[r];
+            for (int c = 0; cellBits != 0; ++c, cellBits >>= 1){
+                if (cellBits & 1u){
+                    backgrounds[backgroundCount++] = cell_rect(r, c);
+                }
+            }
+        }
+
+        if (backgroundCount == 0){
+            return false;
+        }
+
+        SDL_SetRenderDrawColor(renderer, COLOR_BLACK.r, COLOR_BLACK.g, COLOR_BLACK.b, COLOR_BLACK.a);
+        SDL_RenderFillRects(renderer, backgrounds, backgroundCount);
+
+        // then the board, the ghost and the block, only inside what was wiped.
+        for (int r = TETRIS_EXTRA_HEIGHT; r < TETRIS_ALL_HEIGHT; ++r){
+            RowBits cellBits = dirtyCells[r] & tetrisMap.get_row(r);
+
+            for (int c = 0; cellBits != 0; ++c, cellBits >>= 1){
+                if (cellBits & 1u){
+                    add_cell(r, c, tetrisMap.get(r, c));
+                }
+            }
+        }
+
+        add_ghost_cells(ghost, blockInfo, [&dirtyCells](int row, int col) {
+            return ((dirtyCells[row] >> col) & 1u) != 0;
+        });
+
+        blockInfo.for_each_shape_point([this, &blockInfo, &dirtyCells] (int row, int col) {
+            if (is_visible(row) && ((dirtyCells[row] >> col) & 1u)){
+                add_cell(row, col, blockInfo.get_block());
+            }
+        });
+
+        flush_cells();
+        return true;
+    }
+
+    /**
+    * forget the previous frame, when the target lost its content or was replaced.
+    */
+    void invalidate() noexcept {
+        hasPreviousFrame = false;
+    }
+};
+
+/**
+ * a persistent texture the board is drawn into with TetrisRenderer::render_changes(),
+ * then copied to the window. frames where nothing changed draw nothing at all.
+*/
+class TetrisCanvas {
+    SDL_Renderer* renderer;
+    SDL_Texture* texture = nullptr;
+    TetrisRenderer tetrisRenderer;
+public:
+    TetrisCanvas(SDL_Renderer* _renderer, int width, int height)
+        : renderer{ _renderer }, tetrisRenderer{ _renderer }
+    {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+        if (texture == nullptr){
+            throw std::runtime_error{ std::string{ "create canvas texture failed: " } + SDL_GetError() };
+        }
+    }
+
+    TetrisCanvas(TetrisCanvas const&) = delete;
+    TetrisCanvas& operator=(TetrisCanvas const&) = delete;
+
+    ~TetrisCanvas() noexcept {
+        SDL_DestroyTexture(texture);
+    }
+
+    /**
+    * update the texture from the game, and copy it to the window when it changed or when
+    * force is set (the window was exposed). returns whether the window needs presenting.
+    * Game is a TetrisGame, or a RemoteGame in versus mode.
+    */
+    template <typename Game>
+    bool render(Game& game, bool force = false) noexcept {
+        SDL_SetRenderTarget(renderer, texture);
+        bool changed = tetrisRenderer.render_changes(game.get_map(), game.get_block_info(), game.take_dirty_rows());
+        SDL_SetRenderTarget(renderer, nullptr);
+
+        if (changed || force){
+            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        }
+
+        return changed || force;
+    }
+
+    void set_ghost(bool show) noexcept {
+        tetrisRenderer.set_ghost(show);
+    }
+
+    /**
+    * target textures are lost with SDL_RENDER_TARGETS_RESET, everything is drawn again.
+    */
+    void invalidate() noexcept {
+        tetrisRenderer.invalidate();
+    }
+};
+
+/**
+ * the board drawn by TetrisRasterizer into a streaming texture, instead of through
+ * renderer calls. only the board rows that changed (and the rows the block left or
+ * entered) are rastered, then uploaded with a single SDL_UpdateTexture() covering them.
+*/
+class FramebufferCanvas {
+    SDL_Renderer* renderer;
+    SDL_Texture* texture = nullptr;
+    TetrisRasterizer rasterizer;
+
+    bool hasPreviousFrame = false;
+    BlockInfo previousBlockInfo;
+    BlockInfo previousGhost;
+
+    static DirtyRows rows_of(const BlockInfo& blockInfo) noexcept {
+        DirtyRows rows = 0;
+        blockInfo.for_each_shape_point([&rows](int row, int) {
+            rows |= DirtyRows{ 1 } << row;
+        });
+        return rows;
+    }
+public:
+    FramebufferCanvas(SDL_Renderer* _renderer, int scale)
+        : renderer{ _renderer }, rasterizer{ scale }
+    {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                    rasterizer.get_width(), rasterizer.get_height());
+        if (texture == nullptr){
+            throw std::runtime_error{ std::string{ "create framebuffer texture failed: " } + SDL_GetError() };
+        }
+    }
+
+    FramebufferCanvas(FramebufferCanvas const&) = delete;
+    FramebufferCanvas& operator=(FramebufferCanvas const&) = delete;
+
+    ~FramebufferCanvas() noexcept {
+        SDL_DestroyTexture(texture);
+    }
+
+    /**
+    * same contract as TetrisCanvas::render().
+    */
+    template <typename Game>
+    bool render(Game& game, bool force = false) noexcept {
+        const BlockInfo& blockInfo = game.get_block_info();
+        DirtyRows rows = game.take_dirty_rows();
+
+        BlockInfo ghost = blockInfo;
+        if (rasterizer.get_ghost() && blockInfo.get_block() != Block::Empty){
+            ghost = ghost_block_info(game.get_map(), blockInfo);
+        }
+
+        if (!hasPreviousFrame){
+            rows = ALL_ROWS_DIRTY;
+        }
+        else {
+            if (!same_place(previousBlockInfo, blockInfo)){
+                rows |= rows_of(previousBlockInfo) | rows_of(blockInfo);
+            }
+
+            if (!same_place(previousGhost, ghost)){
+                rows |= rows_of(previousGhost) | rows_of(ghost);
+            }
+        }
+
+        hasPreviousFrame = true;
+        previousBlockInfo = blockInfo;
+        previousGhost = ghost;
+        rows &= ALL_ROWS_DIRTY & ~dirty_row_range(0, TETRIS_EXTRA_HEIGHT - 1);
+
+        if (rows != 0){
+            rasterizer.render_rows(game.get_map(), blockInfo, rows);
+
+            int topRow = TETRIS_EXTRA_HEIGHT;
+            while (((rows >> topRow) & 1u) == 0){
+                ++topRow;
+            }
+
+            int bottomRow = TETRIS_ALL_HEIGHT - 1;
+            while (((rows >> bottomRow) & 1u) == 0){
+                --bottomRow;
+            }
+
+            // one upload for the whole band between the first and the last changed row.
+            int cellSize = rasterizer.get_cell_size();
+            SDL_Rect band = { 0, (topRow - TETRIS_EXTRA_HEIGHT) * cellSize, rasterizer.get_width(), (bottomRow - topRow + 1) * cellSize };
+            SDL_UpdateTexture(texture, &band, rasterizer.get_pixels() + static_cast<std::size_t>(band.y) * rasterizer.get_width(), rasterizer.get_pitch());
+        }
+
+        if (rows != 0 || force){
+            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+            return true;
+        }
+
+        return false;
+    }
+
+    void set_ghost(bool show) noexcept {
+        rasterizer.set_ghost(show);
+        hasPreviousFrame = false;
+    }
+
+    /**
+    * the texture keeps its pixels, but drawing everything again is always safe.
+    */
+    void invalidate() noexcept {
+        hasPreviousFrame = false;
+    }
+};
+
+#endif
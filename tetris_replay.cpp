@@ -0,0 +1,81 @@
+#include <iostream>
+#include <exception>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tetris_core.hpp"
+#include "tetris_replay.hpp"
+#include "tetris_scheduler.hpp"
+
+/**
+ * re-run every game of one or more replay files and check each still ends the way it
+ * was recorded, then print a JSON summary.
+ *
+ * usage: tetris-replay [--threads N] replay-file...
+ *
+ * the files are mapped, not read, and records are verified in parallel straight out of
+ * the mapping. the exit status is 1 if any record does not match.
+*/
+
+using namespace std::string_literals;
+
+int main(int argc, char* argv[]){
+    try {
+        int threads = static_cast<int>(std::thread::hardware_concurrency());
+        std::vector<std::unique_ptr<ReplayFile>> files;
+        std::vector<ReplayRecord const*> records;
+
+        for (int i = 1; i < argc; ++i){
+            if (argv[i] == "--threads"s && i + 1 < argc){
+                threads = std::stoi(argv[++i]);
+                continue;
+            }
+
+            files.push_back(std::make_unique<ReplayFile>(argv[i]));
+            for (ReplayRecord const& record : files.back()->get_records()){
+                records.push_back(&record);
+            }
+        }
+
+        if (files.empty()){
+            throw std::runtime_error{ "usage: tetris-replay [--threads N] replay-file..." };
+        }
+
+        WorkStealingScheduler scheduler{ threads };
+        std::atomic<long> mismatches{ 0 };
+        long events = 0;
+        for (ReplayRecord const* record : records){
+            events += record->eventCount;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        scheduler.run(static_cast<long>(records.size()), [&](int, long index) {
+            if (!records[index]->verify()){
+                ++mismatches;
+            }
+        });
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "{\n"
+                  << "  \"files\": " << files.size() << ",\n"
+                  << "  \"records\": " << records.size() << ",\n"
+                  << "  \"events\": " << events << ",\n"
+                  << "  \"mismatches\": " << mismatches << ",\n"
+                  << "  \"threads\": " << scheduler.get_thread_count() << ",\n"
+                  << "  \"seconds\": " << seconds << ",\n"
+                  << "  \"records_per_second\": " << records.size() / seconds << ",\n"
+                  << "  \"events_per_second\": " << events / seconds << "\n"
+                  << "}\n";
+
+        return mismatches == 0 ? 0 : 1;
+    }
+    catch(std::exception const& e){
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
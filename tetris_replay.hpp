@@ -0,0 +1,342 @@
+#ifndef TETRIS_REPLAY_HPP
+#define TETRIS_REPLAY_HPP
+
+/**
+ * binary replays: the seed of a game plus every action applied to it, with its time.
+ *
+ * a replay file is one or more records back to back, each one a fixed header
+ * followed by its packed events. all numbers are little-endian.
+ *
+ *   offset  size  field
+ *        0     4  magic "TTRP"
+ *        4     2  format version (REPLAY_VERSION)
+ *        6     2  reserved, 0
+ *        8     4  seed
+ *       12     4  number of events
+ *       16     4  size of the packed events in bytes
+ *       20     4  lines cleared at the end of the game
+ *       24     4  blocks placed at the end of the game
+ *       28     -  events
+ *
+ * an event is a single varint (7 bits per byte, low bits first) of
+ * (milliseconds since the previous event << 3) | action, so the usual key press or
+ * gravity tick takes 1 to 2 bytes.
+ *
+ * the final lines / blocks let a reader check that re-running the events still gives
+ * the same game. the block sequence comes from the engine's random generator, so a
+ * replay is only valid for the engine that recorded it; REPLAY_VERSION changes with it.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "tetris_core.hpp"
+#include "tetris_varint.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr char REPLAY_MAGIC[4] = { 'T', 'T', 'R', 'P' };
+constexpr std::uint16_t REPLAY_VERSION = 1;
+constexpr std::size_t REPLAY_HEADER_SIZE = 28;
+constexpr int REPLAY_ACTION_BITS = 3;
+
+struct ReplayEvent {
+    std::uint32_t timeMillisec;   // since the start of the game.
+    Action action;
+};
+
+/**
+ * collects the events of one game, then appends the finished record to a file.
+*/
+class ReplayWriter {
+    std::uint32_t seed = 0;
+    std::uint32_t eventCount = 0;
+    std::uint32_t lastTime = 0;
+    std::vector<std::uint8_t> events;
+
+    static void put_u16(std::vector<std::uint8_t>& out, std::uint16_t value) {
+        out.push_back(static_cast<std::uint8_t>(value));
+        out.push_back(static_cast<std::uint8_t>(value >> 8));
+    }
+
+    static void put_u32(std::vector<std::uint8_t>& out, std::uint32_t value) {
+        for (int i = 0; i < 4; ++i){
+            out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+    }
+public:
+    void begin(std::uint32_t _seed) {
+        seed = _seed;
+        eventCount = 0;
+        lastTime = 0;
+        events.clear();
+    }
+
+    void record(std::uint32_t timeMillisec, Action action) {
+        // time never goes backwards within a game, clamp rather than wrap if a caller slips.
+        std::uint32_t delta = timeMillisec > lastTime ? timeMillisec - lastTime : 0;
+        lastTime += delta;
+
+        put_varint(events, (static_cast<std::uint64_t>(delta) << REPLAY_ACTION_BITS) | static_cast<std::uint8_t>(action));
+        ++eventCount;
+    }
+
+    /**
+    * the whole record (header + events) for a game that ended like game.
+    */
+    template <typename Game>
+    std::vector<std::uint8_t> finish(const Game& game) const {
+        std::vector<std::uint8_t> out(std::begin(REPLAY_MAGIC), std::end(REPLAY_MAGIC));
+        out.reserve(REPLAY_HEADER_SIZE + events.size());
+
+        put_u16(out, REPLAY_VERSION);
+        put_u16(out, 0);
+        put_u32(out, seed);
+        put_u32(out, eventCount);
+        put_u32(out, static_cast<std::uint32_t>(events.size()));
+        put_u32(out, static_cast<std::uint32_t>(game.get_lines_cleared()));
+        put_u32(out, static_cast<std::uint32_t>(game.get_pieces_placed()));
+        out.insert(out.end(), events.begin(), events.end());
+        return out;
+    }
+
+    void append_to_file(std::string const& path, const TetrisGame& game) const {
+        std::vector<std::uint8_t> record = finish(game);
+        std::ofstream file{ path, std::ios::binary | std::ios::app };
+
+        if (!file.write(reinterpret_cast<const char*>(record.data()), static_cast<std::streamsize>(record.size()))){
+            throw std::runtime_error{ "write replay failed: " + path };
+        }
+    }
+};
+
+/**
+ * one record of a replay file, pointing straight into the mapped file.
+*/
+struct ReplayRecord {
+    std::uint32_t seed;
+    std::uint32_t eventCount;
+    std::uint32_t linesCleared;
+    std::uint32_t piecesPlaced;
+    const std::uint8_t* events;
+    std::size_t eventBytes;
+
+    /**
+    * decode the events in order, calling visit(ReplayEvent) for each. throws at the first
+    * event that runs past the record, is longer than any varint, or holds no Action, the
+    * ones before it are visited. the events must fill the record exactly, so bytes left
+    * after the last one throw too.
+    */
+    template <typename Visit>
+    void for_each_event(Visit&& visit) const {
+        const std::uint8_t* p = events;
+        const std::uint8_t* end = events + eventBytes;
+        std::uint32_t time = 0;
+
+        for (std::uint32_t i = 0; i < eventCount; ++i){
+            std::uint64_t value;
+            if (!get_varint(p, end, value)){
+                throw std::runtime_error{ "truncated replay event " + std::to_string(i) + " of seed " + std::to_string(seed) };
+            }
+
+            // 3 bits hold 8 values, one more than there are actions.
+            Action action = static_cast<Action>(value & ((1u << REPLAY_ACTION_BITS) - 1));
+            if (action > Action::HardDrop){
+                throw std::runtime_error{ "bad action in replay event " + std::to_string(i) + " of seed " + std::to_string(seed) };
+            }
+
+            time += static_cast<std::uint32_t>(value >> REPLAY_ACTION_BITS);
+            visit(ReplayEvent{ time, action });
+        }
+
+        if (p != end){
+            throw std::runtime_error{ "bytes left after the replay events of seed " + std::to_string(seed) };
+        }
+    }
+
+    /**
+    * re-run the record from its seed, as fast as possible.
+    */
+    TetrisGame replay() const {
+        TetrisGame game{ seed };
+
+        for_each_event([&game](ReplayEvent const& event) {
+            game.step(event.action);
+        });
+
+        return game;
+    }
+
+    /**
+    * does re-running the events end the way the game did when it was recorded?
+    */
+    bool verify() const {
+        try {
+            TetrisGame game = replay();
+            return static_cast<std::uint32_t>(game.get_lines_cleared()) == linesCleared
+                && static_cast<std::uint32_t>(game.get_pieces_placed()) == piecesPlaced;
+        }
+        catch (std::runtime_error const&) {
+            // events that don't decode can't have been recorded from this game.
+            return false;
+        }
+    }
+};
+
+/**
+ * a replay file mapped read-only into memory, records are parsed in place, never copied.
+*/
+class ReplayFile {
+    const std::uint8_t* data = nullptr;
+    std::size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+    std::vector<ReplayRecord> records;
+
+    static std::uint32_t get_u32(const std::uint8_t* p) noexcept {
+        return static_cast<std::uint32_t>(p[0]) | static_cast<std::uint32_t>(p[1]) << 8
+            | static_cast<std::uint32_t>(p[2]) << 16 | static_cast<std::uint32_t>(p[3]) << 24;
+    }
+
+    void map(std::string const& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE){
+            throw std::runtime_error{ "open replay failed: " + path };
+        }
+
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = static_cast<std::size_t>(fileSize.QuadPart);
+        if (size == 0){
+            return;
+        }
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr){
+            throw std::runtime_error{ "map replay failed: " + path };
+        }
+
+        data = static_cast<const std::uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0){
+            throw std::runtime_error{ "open replay failed: " + path };
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0){
+            close(fd);
+            throw std::runtime_error{ "stat replay failed: " + path };
+        }
+
+        size = static_cast<std::size_t>(st.st_size);
+        if (size == 0){
+            close(fd);
+            return;
+        }
+
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapped == MAP_FAILED){
+            throw std::runtime_error{ "map replay failed: " + path };
+        }
+
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const std::uint8_t*>(mapped);
+#endif
+        if (data == nullptr){
+            throw std::runtime_error{ "map replay failed: " + path };
+        }
+    }
+
+    void unmap() noexcept {
+#ifdef _WIN32
+        if (data != nullptr){
+            UnmapViewOfFile(data);
+        }
+        if (mapping != nullptr){
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE){
+            CloseHandle(file);
+        }
+#else
+        if (data != nullptr){
+            munmap(const_cast<std::uint8_t*>(data), size);
+        }
+#endif
+    }
+
+    void index_records(std::string const& path) {
+        std::size_t offset = 0;
+
+        while (offset < size){
+            const std::uint8_t* p = data + offset;
+
+            if (size - offset < REPLAY_HEADER_SIZE || std::memcmp(p, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0){
+                throw std::runtime_error{ "bad replay record at offset " + std::to_string(offset) + ": " + path };
+            }
+
+            std::uint16_t version = static_cast<std::uint16_t>(p[4] | p[5] << 8);
+            if (version != REPLAY_VERSION){
+                throw std::runtime_error{ "unsupported replay version " + std::to_string(version) + ": " + path };
+            }
+
+            ReplayRecord record;
+            record.seed = get_u32(p + 8);
+            record.eventCount = get_u32(p + 12);
+            record.eventBytes = get_u32(p + 16);
+            record.linesCleared = get_u32(p + 20);
+            record.piecesPlaced = get_u32(p + 24);
+            record.events = p + REPLAY_HEADER_SIZE;
+
+            if (record.eventBytes > size - offset - REPLAY_HEADER_SIZE){
+                throw std::runtime_error{ "truncated replay record at offset " + std::to_string(offset) + ": " + path };
+            }
+
+            records.push_back(record);
+            offset += REPLAY_HEADER_SIZE + record.eventBytes;
+        }
+    }
+public:
+    explicit ReplayFile(std::string const& path) {
+        try {
+            map(path);
+            index_records(path);
+        }
+        catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    ReplayFile(ReplayFile const&) = delete;
+    ReplayFile& operator=(ReplayFile const&) = delete;
+
+    ~ReplayFile() noexcept {
+        unmap();
+    }
+
+    std::vector<ReplayRecord> const& get_records() const noexcept {
+        return records;
+    }
+};
+
+#endif
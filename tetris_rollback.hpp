@@ -0,0 +1,124 @@
+#ifndef TETRIS_ROLLBACK_HPP
+#define TETRIS_ROLLBACK_HPP
+
+/**
+ * the last few frames of a game, to go back to and play again: rollback netcode (a
+ * remote key arrives late, the frames since are replayed with it) and undo in a search.
+ *
+ * frame f is the game's state before its f-th step, plus the action of that step. the
+ * frames live in a ring allocated once, so keeping one costs a copy of
+ * BasicTetrisGame::State and nothing else.
+*/
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "tetris_core.hpp"
+
+template <typename Game>
+class RollbackBuffer {
+    struct Frame {
+        typename Game::State state;
+        Action action = Action::None;
+    };
+
+    std::vector<Frame> frames;
+    long firstFrame = 0;    // the oldest frame still kept.
+    long nextFrame = 0;     // the frame the next advance() records, the game is at its start.
+
+    Frame& slot_of(long frame) noexcept {
+        return frames[static_cast<std::size_t>(frame % static_cast<long>(frames.size()))];
+    }
+
+    Frame& frame_at(long frame) {
+        if (!has_frame(frame)){
+            throw std::out_of_range{ "frame " + std::to_string(frame) + " isn't in the rollback buffer" };
+        }
+
+        return slot_of(frame);
+    }
+public:
+    explicit RollbackBuffer(int capacity)
+        : frames(static_cast<std::size_t>(std::max(capacity, 1)))
+    {}
+
+    int get_capacity() const noexcept {
+        return static_cast<int>(frames.size());
+    }
+
+    long get_first_frame() const noexcept {
+        return firstFrame;
+    }
+
+    long get_next_frame() const noexcept {
+        return nextFrame;
+    }
+
+    bool has_frame(long frame) const noexcept {
+        return frame >= firstFrame && frame < nextFrame;
+    }
+
+    /**
+    * forget every frame, such as when the game is reset. numbering goes on from frame.
+    */
+    void clear(long frame = 0) noexcept {
+        firstFrame = frame;
+        nextFrame = frame;
+    }
+
+    /**
+    * record the game's state as the next frame, then step it with action.
+    * returns the frame's number. the oldest frame goes once the ring is full.
+    */
+    long advance(Game& game, Action action) {
+        Frame& slot = slot_of(nextFrame);
+        slot.state = game.get_state();
+        slot.action = action;
+        game.step(action);
+
+        if (nextFrame - firstFrame == get_capacity()){
+            ++firstFrame;
+        }
+
+        return nextFrame++;
+    }
+
+    Action get_action(long frame) {
+        return frame_at(frame).action;
+    }
+
+    /**
+    * change what was played at frame, such as a remote key predicted wrong.
+    * resimulate() from there to bring the game in line.
+    */
+    void set_action(long frame, Action action) {
+        frame_at(frame).action = action;
+    }
+
+    /**
+    * undo: put the game back at the start of frame, the frames after it are forgotten.
+    */
+    void restore(Game& game, long frame) {
+        game.restore_state(frame_at(frame).state);
+        nextFrame = frame;
+    }
+
+    /**
+    * put the game back at the start of frame and play every recorded action again from
+    * there, recording the new states on the way. the game ends up where it would have
+    * been with the current actions all along. returns how many steps were replayed.
+    */
+    long resimulate(Game& game, long frame) {
+        long lastFrame = nextFrame;
+        restore(game, frame);
+
+        while (nextFrame < lastFrame){
+            advance(game, slot_of(nextFrame).action);
+        }
+
+        return lastFrame - frame;
+    }
+};
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef TETRIS_SCHEDULER_HPP
+#define TETRIS_SCHEDULER_HPP
+
+/**
+ * a work-stealing parallel loop over [0, count).
+ *
+ * every worker starts with an equal slice of the index range and takes indices from
+ * its front. a worker that runs dry steals the back half of the largest slice left,
+ * so long and short tasks still spread evenly. each slice sits on its own cache line
+ * and is only locked by its owner, or by a thief once in a while.
+*/
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingScheduler {
+    struct alignas(64) Slice {
+        std::mutex mutex;
+        long begin = 0;
+        long end = 0;
+    };
+
+    int threadCount;
+
+    static bool take_front(Slice& slice, long& index) {
+        std::lock_guard<std::mutex> lock{ slice.mutex };
+
+        if (slice.begin >= slice.end){
+            return false;
+        }
+
+        index = slice.begin++;
+        return true;
+    }
+
+    /**
+    * move the back half of the biggest other slice into mine, false when there is nothing left anywhere.
+    */
+    static bool steal(std::vector<Slice>& slices, int thief) {
+        for (;;) {
+            int victim = -1;
+            long victimSize = 0;
+
+            for (int i = 0; i < static_cast<int>(slices.size()); ++i){
+                if (i == thief){
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock{ slices[i].mutex };
+                long size = slices[i].end - slices[i].begin;
+                if (size > victimSize){
+                    victim = i;
+                    victimSize = size;
+                }
+            }
+
+            if (victim < 0){
+                return false;
+            }
+
+            Slice& from = slices[victim];
+            std::unique_lock<std::mutex> fromLock{ from.mutex };
+
+            long size = from.end - from.begin;
+            if (size <= 0){
+                // somebody else emptied it while we were looking, look again.
+                continue;
+            }
+
+            long stolenBegin = from.end - (size + 1) / 2;
+            long stolenEnd = from.end;
+            from.end = stolenBegin;
+            fromLock.unlock();
+
+            std::lock_guard<std::mutex> lock{ slices[thief].mutex };
+            slices[thief].begin = stolenBegin;
+            slices[thief].end = stolenEnd;
+            return true;
+        }
+    }
+public:
+    explicit WorkStealingScheduler(int _threadCount = static_cast<int>(std::thread::hardware_concurrency()))
+        : threadCount{ std::max(_threadCount, 1) }
+    {}
+
+    int get_thread_count() const noexcept {
+        return threadCount;
+    }
+
+    /**
+    * call body(worker, index) for every index in [0, count), and wait for all of them.
+    * worker is in [0, get_thread_count()), so body can keep per-worker state without locks.
+    */
+    template <typename Body>
+    void run(long count, Body&& body) {
+        std::vector<Slice> slices(static_cast<std::size_t>(threadCount));
+
+        for (int w = 0; w < threadCount; ++w){
+            slices[w].begin = count * w / threadCount;
+            slices[w].end = count * (w + 1) / threadCount;
+        }
+
+        auto work = [&slices, &body](int worker) {
+            long index;
+
+            do {
+                while (take_front(slices[worker], index)){
+                    body(worker, index);
+                }
+            } while (steal(slices, worker));
+        };
+
+        std::vector<std::thread> threads;
+        for (int w = 1; w < threadCount; ++w){
+            threads.emplace_back(work, w);
+        }
+
+        work(0);
+
+        for (auto& thread : threads){
+            thread.join();
+        }
+    }
+};
+
+#endif
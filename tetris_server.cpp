@@ -0,0 +1,301 @@
+#include <iostream>
+#include <exception>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "tetris_net.hpp"
+#include "tetris_core.hpp"
+#include "tetris_clock.hpp"
+#include "tetris_versus.hpp"
+
+/**
+ * the versus server: every game of every match runs here, clients only send keys.
+ *
+ * usage: tetris-server [--port N] [--players N] [--gravity-ms N] [--seed N]
+ *
+ * clients wait in line as they connect, and every --players of them (2 by default) start
+ * a match. a client who leaves loses the round, and once only one is left in a match,
+ * that one goes back in line for the next match.
+ *
+ * one thread serves everything from one poll() loop. keys are applied as they arrive and
+ * every client whose game changed gets its State in the same iteration, gravity steps
+ * wake the loop on time through each match's FixedStepClock.
+ *
+ * a client that stops reading isn't sent more States while SERVER_MAX_OUTGOING_BYTES are
+ * waiting for it. a State carries everything that changed since the last one sent, so the
+ * first State after it drains brings the client's game up to date in one go.
+*/
+
+using namespace std::string_literals;
+
+// a client this far behind on reading its States gets no new one until it catches up.
+constexpr std::size_t SERVER_MAX_OUTGOING_BYTES = 16 * 1024;
+
+struct ServerOptions {
+    int port = 7777;
+    int players = 2;
+    std::uint32_t gravityMillisec = 500;
+    std::uint32_t seed = std::random_device{}();
+};
+
+struct Match;
+
+struct Player {
+    NetConnection connection;
+    Match* match = nullptr;
+    int seat = 0;
+
+    explicit Player(NetSocket socket)
+        : connection{ std::move(socket) }
+    {}
+};
+
+struct Match {
+    VersusMatch versus;
+    std::vector<Player*> seats;      // nullptr once that player has left.
+    FixedStepClock clock;
+
+    Match(std::vector<Player*> _seats, std::uint32_t seed, std::uint32_t gravityMillisec, std::uint64_t now)
+        : versus{ static_cast<int>(_seats.size()), seed }, seats{ std::move(_seats) }, clock{ 1000000000, gravityMillisec }
+    {
+        clock.start(now);
+    }
+
+    int get_connected_count() const noexcept {
+        return static_cast<int>(std::count_if(seats.begin(), seats.end(), [](Player* player) { return player != nullptr; }));
+    }
+};
+
+std::uint64_t now_nanosec() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+class VersusServer {
+    ServerOptions options;
+    NetSocket listener;
+    std::vector<std::unique_ptr<Player>> players;
+    std::vector<std::unique_ptr<Match>> matches;
+    std::deque<Player*> waiting;
+    std::mt19937 mt;
+    std::vector<PollFd> pollFds;
+    std::vector<std::uint8_t> payload;
+
+    void welcome(Player& player) {
+        std::vector<std::uint8_t>& out = player.connection.begin_frame(MessageWelcome);
+        out.insert(out.end(), {
+            VERSUS_VERSION,
+            static_cast<std::uint8_t>(player.seat),
+            static_cast<std::uint8_t>(player.match->seats.size()),
+            static_cast<std::uint8_t>(TETRIS_WIDTH),
+            static_cast<std::uint8_t>(TETRIS_HEIGHT)
+        });
+        player.connection.end_frame();
+    }
+
+    void start_matches(std::uint64_t now) {
+        while (static_cast<int>(waiting.size()) >= options.players){
+            std::vector<Player*> seats(waiting.begin(), waiting.begin() + options.players);
+            waiting.erase(waiting.begin(), waiting.begin() + options.players);
+
+            matches.push_back(std::make_unique<Match>(seats, mt(), options.gravityMillisec, now));
+
+            for (int seat = 0; seat < options.players; ++seat){
+                seats[seat]->match = matches.back().get();
+                seats[seat]->seat = seat;
+                welcome(*seats[seat]);
+            }
+        }
+    }
+
+    void accept_all() {
+        while (true){
+            NetSocket socket = listener.accept_one();
+            if (!socket.is_open()){
+                return;
+            }
+
+            players.push_back(std::make_unique<Player>(std::move(socket)));
+            waiting.push_back(players.back().get());
+        }
+    }
+
+    void receive(Player& player) {
+        player.connection.fill();
+
+        player.connection.for_each_frame([&player](std::uint8_t type, const std::uint8_t* data, std::size_t size) {
+            if (type != MessageInput || size != 3 || data[0] > static_cast<std::uint8_t>(Action::HardDrop)){
+                return;
+            }
+
+            if (player.match != nullptr){
+                player.match->versus.input(player.seat, static_cast<Action>(data[0]), static_cast<std::uint16_t>(data[1] | data[2] << 8));
+            }
+        });
+    }
+
+    /**
+    * forget a player who left, and end the match if nobody is left to play against.
+    */
+    void remove(Player* player) {
+        waiting.erase(std::remove(waiting.begin(), waiting.end(), player), waiting.end());
+
+        if (Match* match = player->match){
+            match->versus.forfeit(player->seat);
+            match->seats[player->seat] = nullptr;
+
+            if (match->get_connected_count() < std::min(options.players, 2)){
+                // the last one standing goes back in line, ahead of the newcomers.
+                for (Player* left : match->seats){
+                    if (left != nullptr){
+                        left->match = nullptr;
+                        waiting.push_front(left);
+                    }
+                }
+
+                matches.erase(std::find_if(matches.begin(), matches.end(), [match](auto const& m) { return m.get() == match; }));
+            }
+        }
+
+        players.erase(std::find_if(players.begin(), players.end(), [player](auto const& p) { return p.get() == player; }));
+    }
+
+    void send_states() {
+        for (auto const& match : matches){
+            for (Player* player : match->seats){
+                if (player == nullptr || player->connection.get_outgoing_size() >= SERVER_MAX_OUTGOING_BYTES){
+                    continue;
+                }
+
+                payload.clear();
+                if (match->versus.put_state(player->seat, payload)){
+                    std::vector<std::uint8_t>& out = player->connection.begin_frame(MessageState);
+                    out.insert(out.end(), payload.begin(), payload.end());
+                    player->connection.end_frame();
+                }
+            }
+        }
+    }
+
+    int get_poll_timeout(std::uint64_t now) const noexcept {
+        int timeout = -1;
+
+        for (auto const& match : matches){
+            int untilStep = static_cast<int>(match->clock.get_millisec_until_next_step(now));
+            timeout = timeout < 0 ? untilStep : std::min(timeout, untilStep);
+        }
+
+        return timeout;
+    }
+public:
+    explicit VersusServer(ServerOptions const& _options)
+        : options{ _options }, listener{ NetSocket::listen_on(_options.port) }, mt{ _options.seed }
+    {}
+
+    void run() {
+        while (true){
+            pollFds.clear();
+            pollFds.push_back(PollFd{ listener.get_handle(), POLLIN, 0 });
+
+            for (auto const& player : players){
+                short events = POLLIN | (player->connection.has_outgoing() ? POLLOUT : 0);
+                pollFds.push_back(PollFd{ player->connection.get_socket().get_handle(), events, 0 });
+            }
+
+            if (net_poll(pollFds.data(), pollFds.size(), get_poll_timeout(now_nanosec())) < 0){
+                continue;
+            }
+
+            if (pollFds[0].revents & POLLIN){
+                accept_all();
+            }
+
+            std::size_t polled = pollFds.size() - 1;
+            for (std::size_t i = 0; i < polled; ++i){
+                if (pollFds[i + 1].revents != 0){
+                    receive(*players[i]);
+                }
+            }
+
+            std::uint64_t now = now_nanosec();
+            for (auto const& match : matches){
+                for (int steps = match->clock.advance(now); steps > 0; --steps){
+                    match->versus.gravity();
+                }
+
+                match->versus.update_round();
+            }
+
+            std::vector<Player*> gone;
+            for (auto const& player : players){
+                if (player->connection.is_closed()){
+                    gone.push_back(player.get());
+                }
+            }
+
+            for (Player* player : gone){
+                remove(player);
+            }
+
+            start_matches(now);
+            send_states();
+
+            for (auto const& player : players){
+                player->connection.flush();
+            }
+        }
+    }
+};
+
+ServerOptions parse_options(int argc, char* argv[]) {
+    ServerOptions options;
+
+    for (int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--port" && hasValue){
+            options.port = std::stoi(argv[++i]);
+        }
+        else if (arg == "--players" && hasValue){
+            options.players = std::stoi(argv[++i]);
+        }
+        else if (arg == "--gravity-ms" && hasValue){
+            options.gravityMillisec = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        }
+        else if (arg == "--seed" && hasValue){
+            options.seed = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+        }
+        else {
+            throw std::runtime_error{ "unknown option: "s + arg };
+        }
+    }
+
+    if (options.players < 1 || options.players > 255){
+        throw std::runtime_error{ "--players must be between 1 and 255" };
+    }
+
+    if (options.gravityMillisec == 0){
+        throw std::runtime_error{ "--gravity-ms must be positive" };
+    }
+
+    return options;
+}
+
+int main(int argc, char* argv[]){
+    try {
+        ServerOptions options = parse_options(argc, argv);
+        VersusServer server{ options };
+
+        std::cerr << "listening on port " << options.port << ", " << options.players << " players per match\n";
+        server.run();
+    }
+    catch(std::exception const& e){
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef TETRIS_THREAD_POOL_HPP
+#define TETRIS_THREAD_POOL_HPP
+
+/**
+ * a fixed set of worker threads that run parallel_for() batches.
+ *
+ * the calling thread works on the batch too, so a pool of N threads spawns N - 1 workers,
+ * and a pool of 1 thread spawns none and runs everything inline.
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable finished;
+
+    // the current batch, written under mutex before generation is bumped.
+    void (*task)(void* context, int index) = nullptr;
+    void* taskContext = nullptr;
+    int taskSize = 0;
+    std::atomic<int> nextIndex{ 0 };
+
+    unsigned generation = 0;
+    std::size_t pending = 0;
+    bool stopping = false;
+
+    void run_tasks() {
+        for (int i = nextIndex.fetch_add(1); i < taskSize; i = nextIndex.fetch_add(1)){
+            task(taskContext, i);
+        }
+    }
+
+    void worker_loop() {
+        unsigned seenGeneration = 0;
+        std::unique_lock<std::mutex> lock{ mutex };
+
+        for (;;) {
+            wakeUp.wait(lock, [this, seenGeneration] { return stopping || generation != seenGeneration; });
+            if (stopping){
+                return;
+            }
+
+            seenGeneration = generation;
+            lock.unlock();
+            run_tasks();
+            lock.lock();
+
+            if (--pending == 0){
+                finished.notify_one();
+            }
+        }
+    }
+public:
+    explicit ThreadPool(int threadCount) {
+        for (int i = 1; i < threadCount; ++i){
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            stopping = true;
+        }
+
+        wakeUp.notify_all();
+
+        for (auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    int get_thread_count() const noexcept {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    /**
+    * call body(i) for every i in [0, count), spread over the pool, and wait for all of them.
+    * indices are handed out one by one, so uneven tasks still balance.
+    */
+    template <typename Body>
+    void parallel_for(int count, Body&& body) {
+        if (workers.empty() || count <= 1){
+            for (int i = 0; i < count; ++i){
+                body(i);
+            }
+            return;
+        }
+
+        using BodyType = std::remove_reference_t<Body>;
+
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            task = [](void* context, int index) { (*static_cast<BodyType*>(context))(index); };
+            taskContext = const_cast<void*>(static_cast<const void*>(&body));
+            taskSize = count;
+            nextIndex = 0;
+            pending = workers.size();
+            ++generation;
+        }
+
+        wakeUp.notify_all();
+        run_tasks();
+
+        std::unique_lock<std::mutex> lock{ mutex };
+        finished.wait(lock, [this] { return pending == 0; });
+    }
+};
+
+#endif
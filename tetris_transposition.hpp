@@ -0,0 +1,90 @@
+#ifndef TETRIS_TRANSPOSITION_HPP
+#define TETRIS_TRANSPOSITION_HPP
+
+/**
+ * a fixed-size cache of scores by position hash (BasicTetrisMap::get_hash()), shared by
+ * every thread of a search without a lock.
+ *
+ * an entry is two 64-bit words, the score and key ^ score. threads read and write them
+ * with relaxed atomics, so two writers can interleave and leave one word of each in an
+ * entry. such an entry no longer checks out (key ^ score doesn't give back the key) and
+ * is treated as empty. a new score always replaces the old one in its slot.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+class TranspositionTable {
+    struct Entry {
+        std::atomic<std::uint64_t> check{ 0 };     // key ^ data.
+        std::atomic<std::uint64_t> data{ 0 };
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    std::uint64_t mask;
+
+    static std::uint64_t to_bits(double score) noexcept {
+        std::uint64_t bits;
+        std::memcpy(&bits, &score, sizeof(bits));
+        return bits;
+    }
+
+    static double from_bits(std::uint64_t bits) noexcept {
+        double score;
+        std::memcpy(&score, &bits, sizeof(score));
+        return score;
+    }
+public:
+    /**
+    * room for entryCount scores, rounded down to a power of two, 16 bytes each.
+    */
+    explicit TranspositionTable(std::size_t entryCount) {
+        std::size_t size = 1;
+        while (size * 2 <= entryCount){
+            size *= 2;
+        }
+
+        entries = std::make_unique<Entry[]>(size);
+        mask = size - 1;
+    }
+
+    std::size_t get_size() const noexcept {
+        return static_cast<std::size_t>(mask + 1);
+    }
+
+    /**
+    * the score stored for key, false if there is none.
+    */
+    bool probe(std::uint64_t key, double& score) const noexcept {
+        Entry const& entry = entries[key & mask];
+        std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+        std::uint64_t check = entry.check.load(std::memory_order_relaxed);
+
+        // an empty entry reads as key 0, the hash of the empty board only.
+        if ((check ^ data) != key){
+            return false;
+        }
+
+        score = from_bits(data);
+        return true;
+    }
+
+    void store(std::uint64_t key, double score) noexcept {
+        Entry& entry = entries[key & mask];
+        std::uint64_t data = to_bits(score);
+
+        entry.data.store(data, std::memory_order_relaxed);
+        entry.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    void clear() noexcept {
+        for (std::size_t i = 0; i < get_size(); ++i){
+            entries[i].check.store(0, std::memory_order_relaxed);
+            entries[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif
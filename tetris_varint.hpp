@@ -0,0 +1,39 @@
+#ifndef TETRIS_VARINT_HPP
+#define TETRIS_VARINT_HPP
+
+/**
+ * unsigned varints, 7 bits per byte, low bits first, the high bit set on every byte but
+ * the last. replay events and versus messages are both packed with them.
+*/
+
+#include <cstdint>
+#include <vector>
+
+inline void put_varint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    do {
+        std::uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out.push_back(value != 0 ? byte | 0x80 : byte);
+    } while (value != 0);
+}
+
+/**
+ * reads what put_varint() wrote from [p, end), returns false if it runs past end or
+ * past the 10 bytes a 64-bit value can take.
+*/
+inline bool get_varint(const std::uint8_t*& p, const std::uint8_t* end, std::uint64_t& value) noexcept {
+    value = 0;
+
+    for (int shift = 0; p < end && shift < 64; shift += 7){
+        std::uint8_t byte = *p++;
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif
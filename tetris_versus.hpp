@@ -0,0 +1,675 @@
+#ifndef TETRIS_VERSUS_HPP
+#define TETRIS_VERSUS_HPP
+
+/**
+ * versus mode: N players, each on their own board, where lines cleared by one player
+ * push garbage rows up into an opponent's board.
+ *
+ * the server runs every game (VersusMatch), clients only send keys and draw what they are
+ * told. the server applies a key as soon as it arrives and answers in the same poll
+ * iteration, so the only delay a key sees is the network round trip.
+ *
+ * messages (frames of tetris_net.hpp, little-endian):
+ *
+ *   Input    client -> server  u8 action, u16 sequence number
+ *   Welcome  server -> client  u8 version, u8 seat, u8 players, u8 width, u8 height
+ *   State    server -> client  u16 last sequence number applied, u8 fields, then the fields:
+ *     StateBlock      u8 block << 2 | rotation, u8 row, u8 column + 2
+ *     StateRows       varint mask of the changed rows, then per row (top down) its
+ *                     bitboard word (width / 8 bytes) and a 4-bit colour per occupied cell
+ *     StateStats      varint lines cleared, u8 garbage rows waiting
+ *     StateGameOver   -
+ *     StateOpponents  u8 count, then per opponent u8 seat, varint lines, u8 alive
+ *     StateRound      varint round number, the mirror starts from an empty board
+ *
+ * a State carries only what changed since the previous one: typically a moved block,
+ * 9 bytes on the wire, or a landed block and the few rows it changed. a client sees the
+ * scores of its opponents, not their boards, so the traffic of a player doesn't grow
+ * with the number of players.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tetris_core.hpp"
+#include "tetris_net.hpp"
+
+constexpr std::uint8_t VERSUS_VERSION = 1;
+
+enum VersusMessage : std::uint8_t {
+    MessageInput = 1,
+    MessageWelcome = 2,
+    MessageState = 3
+};
+
+enum VersusStateField : std::uint8_t {
+    StateBlock = 1,
+    StateRows = 2,
+    StateStats = 4,
+    StateGameOver = 8,
+    StateOpponents = 16,
+    StateRound = 32
+};
+
+/**
+ * garbage rows sent for clearing 0, 1, 2, 3 or 4 lines at once.
+*/
+constexpr int garbage_for_lines(int lines) noexcept {
+    constexpr int garbage[] = { 0, 0, 1, 2, 4 };
+    return garbage[std::clamp(lines, 0, 4)];
+}
+
+constexpr int VERSUS_ROW_BYTES = static_cast<int>(sizeof(RowBits));
+
+/**
+ * the StateRows field of the rows in dirtyRows.
+*/
+inline void put_rows(std::vector<std::uint8_t>& out, const TetrisMap& tetrisMap, DirtyRows dirtyRows) {
+    put_varint(out, dirtyRows);
+
+    for (int r = 0; r < TETRIS_ALL_HEIGHT; ++r){
+        if (((dirtyRows >> r) & 1u) == 0){
+            continue;
+        }
+
+        RowBits row = tetrisMap.get_row(r);
+        for (int i = 0; i < VERSUS_ROW_BYTES; ++i){
+            out.push_back(static_cast<std::uint8_t>(row >> (8 * i)));
+        }
+
+        // two colours per byte, only for the occupied cells.
+        int nibble = 0;
+        for (int c = 0; c < TETRIS_WIDTH; ++c){
+            if ((row >> c) & 1u){
+                std::uint8_t color = static_cast<std::uint8_t>(tetrisMap.get(r, c));
+
+                if (nibble++ % 2 == 0){
+                    out.push_back(color);
+                }
+                else {
+                    out.back() |= static_cast<std::uint8_t>(color << 4);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * what a client knows of an opponent.
+*/
+struct OpponentStatus {
+    int seat = 0;
+    int lines = 0;
+    bool alive = true;
+};
+
+/**
+ * the client's copy of its own game, kept up to date by State messages. it reads like a
+ * TetrisGame to the canvases: get_map(), get_block_info() and take_dirty_rows().
+*/
+class RemoteGame {
+    /**
+    * everything a State can change. a State is decoded into a copy of this, which only
+    * replaces the current one once the whole payload has checked out.
+    */
+    struct Mirror {
+        TetrisMap tetrisMap;
+        BlockInfo blockInfo;
+        int linesCleared = 0;
+        int pendingGarbage = 0;
+        bool gameOver = false;
+        std::uint32_t round = 0;
+        std::uint16_t lastInput = 0;
+        std::vector<OpponentStatus> opponents;
+    };
+
+    Mirror mirror;
+    Mirror staged;      // kept between States so its opponents don't allocate every time.
+
+    static bool get_u8(const std::uint8_t*& p, const std::uint8_t* end, std::uint8_t& value) noexcept {
+        if (p >= end){
+            return false;
+        }
+
+        value = *p++;
+        return true;
+    }
+
+    static bool get_rows(const std::uint8_t*& p, const std::uint8_t* end, TetrisMap& tetrisMap) noexcept {
+        std::uint64_t dirtyRows;
+        if (!get_varint(p, end, dirtyRows) || (dirtyRows & ~ALL_ROWS_DIRTY) != 0){
+            return false;
+        }
+
+        for (int r = 0; r < TETRIS_ALL_HEIGHT; ++r){
+            if (((dirtyRows >> r) & 1u) == 0){
+                continue;
+            }
+
+            if (end - p < VERSUS_ROW_BYTES){
+                return false;
+            }
+
+            RowBits row = 0;
+            for (int i = 0; i < VERSUS_ROW_BYTES; ++i){
+                row |= static_cast<RowBits>(static_cast<RowBits>(*p++) << (8 * i));
+            }
+
+            if ((row & ~TETRIS_FULL_ROW) != 0){
+                return false;
+            }
+
+            int nibble = 0;
+            for (int c = 0; c < TETRIS_WIDTH; ++c){
+                if (((row >> c) & 1u) == 0){
+                    tetrisMap.set(r, c, Block::Empty);
+                    continue;
+                }
+
+                if (nibble % 2 == 0 && p >= end){
+                    return false;
+                }
+
+                int color = nibble++ % 2 == 0 ? *p & 0x0F : *p++ >> 4;
+                tetrisMap.set(r, c, static_cast<Block>(std::min(color, static_cast<int>(Block::Garbage))));
+            }
+
+            if (nibble % 2 == 1){
+                ++p;
+            }
+        }
+
+        return true;
+    }
+    /**
+    * the block must lie on the board, or drawing it and finding its ghost would reach past
+    * the rows. it can only overlap the board once the game is over: the block that didn't
+    * fit, or a board filled by a forfeit.
+    */
+    static bool is_valid_block(Mirror const& state) noexcept {
+        if (state.blockInfo.get_block() == Block::Empty){
+            return true;
+        }
+
+        bool onBoard = true;
+        state.blockInfo.for_each_shape_point([&onBoard](int row, int col) {
+            onBoard = onBoard && row >= 0 && row < TETRIS_ALL_HEIGHT && col >= 0 && col < TETRIS_WIDTH;
+        });
+
+        return onBoard && (state.gameOver || !state.tetrisMap.collides(state.blockInfo));
+    }
+public:
+    /**
+    * apply one State payload, false if it is malformed. a malformed State changes nothing.
+    */
+    bool apply_state(const std::uint8_t* p, std::size_t size) noexcept {
+        const std::uint8_t* end = p + size;
+        std::uint8_t fields, low, high;
+
+        if (!get_u8(p, end, low) || !get_u8(p, end, high) || !get_u8(p, end, fields)){
+            return false;
+        }
+
+        staged = mirror;
+        staged.lastInput = static_cast<std::uint16_t>(low | high << 8);
+
+        if (fields & StateRound){
+            std::uint64_t value;
+            if (!get_varint(p, end, value)){
+                return false;
+            }
+
+            staged.round = static_cast<std::uint32_t>(value);
+            staged.tetrisMap.clear();
+            staged.linesCleared = 0;
+            staged.pendingGarbage = 0;
+            staged.gameOver = false;
+        }
+
+        if (fields & StateBlock){
+            std::uint8_t kind, row, col;
+            if (!get_u8(p, end, kind) || !get_u8(p, end, row) || !get_u8(p, end, col)){
+                return false;
+            }
+
+            if ((kind >> 2) >= static_cast<int>(Block::Garbage) || row >= TETRIS_ALL_HEIGHT || col >= PIECE_MASK_COLS){
+                return false;
+            }
+
+            staged.blockInfo = BlockInfo{ static_cast<Block>(kind >> 2), row, col - PIECE_MASK_COL_OFFSET, kind & 3 };
+        }
+
+        if ((fields & StateRows) && !get_rows(p, end, staged.tetrisMap)){
+            return false;
+        }
+
+        if (fields & StateStats){
+            std::uint64_t lines;
+            std::uint8_t garbage;
+            if (!get_varint(p, end, lines) || !get_u8(p, end, garbage)){
+                return false;
+            }
+
+            staged.linesCleared = static_cast<int>(lines);
+            staged.pendingGarbage = garbage;
+        }
+
+        if (fields & StateGameOver){
+            staged.gameOver = true;
+        }
+
+        if (fields & StateOpponents){
+            std::uint8_t count;
+            if (!get_u8(p, end, count)){
+                return false;
+            }
+
+            staged.opponents.resize(count);
+            for (OpponentStatus& opponent : staged.opponents){
+                std::uint8_t seat, alive;
+                std::uint64_t lines;
+                if (!get_u8(p, end, seat) || !get_varint(p, end, lines) || !get_u8(p, end, alive)){
+                    return false;
+                }
+
+                opponent = OpponentStatus{ seat, static_cast<int>(lines), alive != 0 };
+            }
+        }
+
+        if (p != end || !is_valid_block(staged)){
+            return false;
+        }
+
+        mirror = staged;
+        return true;
+    }
+
+    /**
+    * whether a round has started, before that there is no block to draw.
+    */
+    bool is_started() const noexcept {
+        return mirror.round != 0;
+    }
+
+    const TetrisMap& get_map() const noexcept {
+        return mirror.tetrisMap;
+    }
+
+    const BlockInfo& get_block_info() const noexcept {
+        return mirror.blockInfo;
+    }
+
+    DirtyRows take_dirty_rows() noexcept {
+        DirtyRows dirtyRows = mirror.tetrisMap.get_dirty_rows();
+        mirror.tetrisMap.clear_dirty_rows();
+        return dirtyRows;
+    }
+
+    bool is_game_over() const noexcept {
+        return mirror.gameOver;
+    }
+
+    int get_lines_cleared() const noexcept {
+        return mirror.linesCleared;
+    }
+
+    int get_pending_garbage() const noexcept {
+        return mirror.pendingGarbage;
+    }
+
+    std::uint32_t get_round() const noexcept {
+        return mirror.round;
+    }
+
+    /**
+    * the sequence number of the last Input the server had applied when it sent this state.
+    */
+    std::uint16_t get_last_input() const noexcept {
+        return mirror.lastInput;
+    }
+
+    std::vector<OpponentStatus> const& get_opponents() const noexcept {
+        return mirror.opponents;
+    }
+};
+
+/**
+ * the games of one versus match, on the server.
+ *
+ * a player's cleared lines first cancel the garbage waiting for them, the rest goes to
+ * the next player still alive (seat + 1, + 2, ...). waiting garbage arrives when its
+ * receiver's next block lands without clearing anything, with the hole in a random column.
+ * once at most one player is left (none, playing alone), a new round starts for everyone.
+*/
+class VersusMatch {
+    struct Seat {
+        TetrisGame game;
+        int pendingGarbage = 0;
+
+        // what the player's client has been sent so far.
+        DirtyRows unsentRows = ALL_ROWS_DIRTY;
+        BlockInfo sentBlockInfo;
+        bool blockSent = false;
+        bool statsChanged = true;
+        bool gameOverSent = false;
+        bool roundChanged = true;
+        std::uint64_t opponentsVersionSent = 0;
+        std::uint16_t lastInput = 0;
+        std::uint16_t lastInputSent = 0;
+    };
+
+    std::vector<Seat> seats;
+    std::mt19937 mt;
+    std::uint32_t round = 0;
+    std::uint64_t opponentsVersion = 1;    // bumped whenever any seat's score or state changes.
+
+    void on_landed(int seat) {
+        Seat& player = seats[seat];
+        int garbage = garbage_for_lines(player.game.get_last_cleared_lines().count);
+
+        int cancelled = std::min(garbage, player.pendingGarbage);
+        player.pendingGarbage -= cancelled;
+        garbage -= cancelled;
+
+        if (garbage > 0){
+            for (int i = 1; i < static_cast<int>(seats.size()); ++i){
+                Seat& target = seats[(seat + i) % seats.size()];
+
+                if (!target.game.is_game_over()){
+                    target.pendingGarbage = std::min(target.pendingGarbage + garbage, TETRIS_HEIGHT);
+                    target.statsChanged = true;
+                    break;
+                }
+            }
+        }
+        else if (player.game.get_last_cleared_lines().count == 0 && player.pendingGarbage > 0){
+            player.game.add_garbage(player.pendingGarbage, static_cast<int>(mt() % TETRIS_WIDTH));
+            player.pendingGarbage = 0;
+        }
+
+        player.statsChanged = true;
+        ++opponentsVersion;
+    }
+
+    void step(int seat, Action action) {
+        Seat& player = seats[seat];
+        int pieces = player.game.get_pieces_placed();
+
+        player.game.step(action);
+
+        if (player.game.get_pieces_placed() != pieces){
+            on_landed(seat);
+        }
+    }
+
+    int get_alive_count() const noexcept {
+        return static_cast<int>(std::count_if(seats.begin(), seats.end(), [](Seat const& player) {
+            return !player.game.is_game_over();
+        }));
+    }
+public:
+    VersusMatch(int players, std::uint32_t seed)
+        : seats(static_cast<std::size_t>(std::max(players, 1))), mt{ seed }
+    {
+        start_round();
+    }
+
+    int get_player_count() const noexcept {
+        return static_cast<int>(seats.size());
+    }
+
+    std::uint32_t get_round() const noexcept {
+        return round;
+    }
+
+    const TetrisGame& get_game(int seat) const noexcept {
+        return seats[seat].game;
+    }
+
+    void start_round() {
+        ++round;
+        ++opponentsVersion;
+
+        for (Seat& player : seats){
+            player.game.reset(mt());
+            player.game.take_dirty_rows();
+            player.pendingGarbage = 0;
+            player.unsentRows = ALL_ROWS_DIRTY;
+            player.blockSent = false;
+            player.statsChanged = true;
+            player.gameOverSent = false;
+            player.roundChanged = true;
+        }
+    }
+
+    /**
+    * a key from seat's client, with the sequence number to acknowledge.
+    */
+    void input(int seat, Action action, std::uint16_t sequence) {
+        seats[seat].lastInput = sequence;
+        step(seat, action);
+    }
+
+    /**
+    * one gravity step for every player still in the game.
+    */
+    void gravity() {
+        for (int seat = 0; seat < get_player_count(); ++seat){
+            step(seat, Action::Gravity);
+        }
+    }
+
+    /**
+    * a player who left the match loses the round.
+    */
+    void forfeit(int seat) {
+        // a board full of garbage is lost.
+        seats[seat].game.add_garbage(TETRIS_ALL_HEIGHT, 0);
+        ++opponentsVersion;
+    }
+
+    /**
+    * start the next round if this one is decided, returns whether it did.
+    */
+    bool update_round() {
+        if (get_alive_count() > (get_player_count() > 1 ? 1 : 0)){
+            return false;
+        }
+
+        start_round();
+        return true;
+    }
+
+    /**
+    * append the State payload of what seat's client hasn't seen yet to out,
+    * returns false (and appends nothing) when there is nothing new, not even a key to acknowledge.
+    */
+    bool put_state(int seat, std::vector<std::uint8_t>& out) {
+        Seat& player = seats[seat];
+        TetrisGame& game = player.game;
+
+        player.unsentRows |= game.take_dirty_rows();
+
+        std::uint8_t fields = 0;
+        fields |= player.roundChanged ? StateRound : 0;
+        fields |= !player.blockSent || !same_place(player.sentBlockInfo, game.get_block_info()) ? StateBlock : 0;
+        fields |= player.unsentRows != 0 ? StateRows : 0;
+        fields |= player.statsChanged ? StateStats : 0;
+        fields |= game.is_game_over() && !player.gameOverSent ? StateGameOver : 0;
+        fields |= player.opponentsVersionSent != opponentsVersion && get_player_count() > 1 ? StateOpponents : 0;
+
+        // a key that changed nothing is still acknowledged, with an empty State.
+        if (fields == 0 && player.lastInput == player.lastInputSent){
+            return false;
+        }
+
+        out.push_back(static_cast<std::uint8_t>(player.lastInput));
+        out.push_back(static_cast<std::uint8_t>(player.lastInput >> 8));
+        out.push_back(fields);
+
+        if (fields & StateRound){
+            put_varint(out, round);
+        }
+
+        if (fields & StateBlock){
+            BlockInfo const& blockInfo = game.get_block_info();
+            out.push_back(static_cast<std::uint8_t>(static_cast<int>(blockInfo.get_block()) << 2 | blockInfo.get_rotate_times()));
+            out.push_back(static_cast<std::uint8_t>(blockInfo.get_pos().row));
+            out.push_back(static_cast<std::uint8_t>(blockInfo.get_pos().col + PIECE_MASK_COL_OFFSET));
+        }
+
+        if (fields & StateRows){
+            put_rows(out, game.get_map(), player.unsentRows);
+        }
+
+        if (fields & StateStats){
+            put_varint(out, static_cast<std::uint64_t>(game.get_lines_cleared()));
+            out.push_back(static_cast<std::uint8_t>(player.pendingGarbage));
+        }
+
+        if (fields & StateOpponents){
+            out.push_back(static_cast<std::uint8_t>(get_player_count() - 1));
+
+            for (int other = 0; other < get_player_count(); ++other){
+                if (other != seat){
+                    out.push_back(static_cast<std::uint8_t>(other));
+                    put_varint(out, static_cast<std::uint64_t>(seats[other].game.get_lines_cleared()));
+                    out.push_back(seats[other].game.is_game_over() ? 0 : 1);
+                }
+            }
+        }
+
+        player.lastInputSent = player.lastInput;
+        player.roundChanged = false;
+        player.blockSent = true;
+        player.sentBlockInfo = game.get_block_info();
+        player.unsentRows = 0;
+        player.statsChanged = false;
+        player.gameOverSent = player.gameOverSent || game.is_game_over();
+        player.opponentsVersionSent = opponentsVersion;
+        return true;
+    }
+};
+
+/**
+ * a player's end of a match, for the game window: the socket is read by a thread of its
+ * own that wakes the window (notify()) when bytes arrive, the window thread applies them
+ * in poll() and sends keys with send_input().
+*/
+class VersusClient {
+    NetConnection connection;
+    RemoteGame remoteGame;
+    int seat = 0;
+    int playerCount = 0;
+    std::uint16_t sequence = 0;
+
+    std::mutex mutex;
+    std::vector<std::uint8_t> received;
+    std::atomic<bool> disconnected{ false };
+    std::function<void()> notify;
+    std::thread reader;
+
+    void read_loop() {
+        std::uint8_t buffer[4096];
+
+        while (true){
+            long count = connection.get_socket().receive_some(buffer, sizeof(buffer));
+
+            if (count < 0){
+                disconnected = true;
+                notify();
+                return;
+            }
+
+            if (count > 0){
+                std::lock_guard<std::mutex> lock{ mutex };
+                received.insert(received.end(), buffer, buffer + count);
+            }
+
+            notify();
+        }
+    }
+public:
+    VersusClient(std::string const& host, std::string const& port, std::function<void()> _notify)
+        : connection{ NetSocket::connect_to(host, port) }, notify{ std::move(_notify) }
+    {
+        // the reader thread waits in recv(), keys are written from the window thread.
+        connection.get_socket().set_blocking();
+        reader = std::thread{ [this] { read_loop(); } };
+    }
+
+    VersusClient(const VersusClient&) = delete;
+    VersusClient& operator=(const VersusClient&) = delete;
+
+    ~VersusClient() {
+        connection.get_socket().shutdown_both();
+        reader.join();
+    }
+
+    /**
+    * apply what arrived since the last call, returns whether the game changed.
+    * throws once the server is gone or sent something this client can't read.
+    */
+    bool poll() {
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            connection.append_incoming(received.data(), received.size());
+            received.clear();
+        }
+
+        bool changed = false;
+        connection.for_each_frame([this, &changed](std::uint8_t type, const std::uint8_t* payload, std::size_t size) {
+            if (type == MessageWelcome){
+                if (size != 5 || payload[0] != VERSUS_VERSION || payload[3] != TETRIS_WIDTH || payload[4] != TETRIS_HEIGHT){
+                    throw std::runtime_error{ "the server plays another version or board size" };
+                }
+
+                seat = payload[1];
+                playerCount = payload[2];
+            }
+            else if (type == MessageState){
+                if (!remoteGame.apply_state(payload, size)){
+                    throw std::runtime_error{ "malformed state from the server" };
+                }
+
+                changed = true;
+            }
+        });
+
+        if (disconnected || connection.is_closed()){
+            throw std::runtime_error{ "disconnected from the server" };
+        }
+
+        return changed;
+    }
+
+    void send_input(Action action) {
+        std::vector<std::uint8_t>& out = connection.begin_frame(MessageInput);
+        ++sequence;
+        out.push_back(static_cast<std::uint8_t>(action));
+        out.push_back(static_cast<std::uint8_t>(sequence));
+        out.push_back(static_cast<std::uint8_t>(sequence >> 8));
+        connection.end_frame();
+        connection.flush();
+    }
+
+    RemoteGame& get_game() noexcept {
+        return remoteGame;
+    }
+
+    int get_seat() const noexcept {
+        return seat;
+    }
+
+    int get_player_count() const noexcept {
+        return playerCount;
+    }
+};
+
+#endif